@@ -0,0 +1,93 @@
+/*
+* Copyright (C) 2015 Axios, Inc.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "AllocationCounter.h"
+
+#ifdef FREQSHIFT_DEBUG_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+static __thread bool counting = false;
+static volatile long allocations = 0;
+
+void *operator new(size_t size) throw (std::bad_alloc)
+{
+	if(counting)
+		__sync_fetch_and_add(&allocations, 1);
+	void *p = malloc(size ? size : 1);
+	if(!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](size_t size) throw (std::bad_alloc)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) throw ()
+{
+	free(p);
+}
+
+void operator delete[](void *p) throw ()
+{
+	free(p);
+}
+
+AllocationCounter::Scope::Scope(bool enable) : previous(counting)
+{
+	counting = enable;
+}
+
+AllocationCounter::Scope::~Scope()
+{
+	counting = previous;
+}
+
+void AllocationCounter::record()
+{
+	if(counting)
+		__sync_fetch_and_add(&allocations, 1);
+}
+
+long AllocationCounter::count()
+{
+	return allocations;
+}
+
+#else
+
+AllocationCounter::Scope::Scope(bool enable) : previous(false)
+{
+}
+
+AllocationCounter::Scope::~Scope()
+{
+}
+
+void AllocationCounter::record()
+{
+}
+
+long AllocationCounter::count()
+{
+	return -1;
+}
+
+#endif
@@ -0,0 +1,45 @@
+/*
+* Copyright (C) 2015 Axios, Inc.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+//Counts heap allocations made by a thread while it is inside a counting Scope. Counting is
+//only compiled in when FREQSHIFT_DEBUG_ALLOCATIONS is defined (configure with
+//--enable-allocation-debug), in which case the global operator new is replaced; otherwise
+//Scope does nothing and count() returns -1.
+class AllocationCounter
+{
+public:
+	//Turns counting on or off for the calling thread until the scope ends, so a counted
+	//region can pause around calls whose allocations are not its own
+	class Scope
+	{
+	public:
+		Scope(bool counting);
+		~Scope();
+	private:
+		bool previous;
+	};
+
+	//Counts an allocation made other than through operator new
+	static void record();
+
+	static long count();
+};
+
+#endif // ALLOCATIONCOUNTER_H
@@ -16,13 +16,214 @@
 */
 
 #include "FreqShift.h"
+#include "AllocationCounter.h"
+#include <fnmatch.h>
 
 PREPARE_LOGGING(FreqShift_i)
 
-FreqShift_i::FreqShift_i(const char *uuid, const char *label) :FreqShift_base(uuid, label), firstTime(true), phasor(NULL){}
+//Longest wait on one input port while the others may have packets arriving, in seconds
+static const float INPUT_POLL_INTERVAL = 0.01;
+
+//Tells the processor the thread is spinning, so that it neither floods the memory bus
+//nor starves a sibling hyperthread
+static inline void spinPause()
+{
+#ifdef __SSE2__
+	_mm_pause();
+#endif
+}
+
+//Stack faulted in by the processing thread when memory is locked, in bytes
+static const size_t STACK_PREFAULT = 256*1024;
+
+//Returns T moved forward by the given number of seconds, keeping the fractional
+//seconds normalized to [0, 1)
+static BULKIO::PrecisionUTCTime advanceTime(const BULKIO::PrecisionUTCTime &T, double seconds)
+{
+	BULKIO::PrecisionUTCTime result = T;
+	result.tfsec += seconds;
+	double whole = floor(result.tfsec);
+	result.twsec += whole;
+	result.tfsec -= whole;
+	return result;
+}
+
+//Reads an SRI keyword holding a number of any CORBA numeric type, returning false when
+//there is no keyword with the given ID or its value is not a number
+static bool numericKeyword(const CF::Properties &keywords, const string &id, double &value)
+{
+	for(unsigned int i=0;i<keywords.length();i++)
+	{
+		if(strcmp(keywords[i].id, id.c_str()))
+			continue;
+
+		const CORBA::Any &any = keywords[i].value;
+		CORBA::Double d;
+		CORBA::Float f;
+		CORBA::Long l;
+		CORBA::ULong ul;
+		CORBA::Short sh;
+		CORBA::UShort us;
+		CORBA::LongLong ll;
+		if(any >>= d)
+			value = d;
+		else if(any >>= f)
+			value = f;
+		else if(any >>= l)
+			value = l;
+		else if(any >>= ul)
+			value = ul;
+		else if(any >>= sh)
+			value = sh;
+		else if(any >>= us)
+			value = us;
+		else if(any >>= ll)
+			value = ll;
+		else
+			return false;
+		return true;
+	}
+	return false;
+}
+
+FreqShift_i::FreqShift_i(const char *uuid, const char *label) :FreqShift_base(uuid, label), state(NULL), pendingCount(0), wakeups(0), packetRate(0), lastInput(ShiftKernel::FLOAT_INPUT), defaultPriority(0), channelShiftsVersion(0), frequencyOverridesVersion(0), connectionTableVersion(0), numaNode(-1), schedulingPolicy("SCHED_OTHER"), schedulingPriority(1), lockMemory(false), memoryLocked(false), placedNode(-1), placementVersion(1), appliedPlacementVersion(0), threadBound(false), memoryPolicySet(false), threadScheduled(false)
+{
+	addPropertyChangeListener("stream_priorities", this, &FreqShift_i::stream_prioritiesChanged);
+	addPropertyChangeListener("default_priority", this, &FreqShift_i::default_priorityChanged);
+	addPropertyChangeListener("channel_shifts", this, &FreqShift_i::channel_shiftsChanged);
+	addPropertyChangeListener("stream_frequencies", this, &FreqShift_i::stream_frequenciesChanged);
+	addPropertyChangeListener("frequency_keyword", this, &FreqShift_i::frequency_keywordChanged);
+	addPropertyChangeListener("numa_node", this, &FreqShift_i::numa_nodeChanged);
+	addPropertyChangeListener("cpu_affinity", this, &FreqShift_i::cpu_affinityChanged);
+	addPropertyChangeListener("scheduling_policy", this, &FreqShift_i::scheduling_policyChanged);
+	addPropertyChangeListener("scheduling_priority", this, &FreqShift_i::scheduling_priorityChanged);
+	addPropertyChangeListener("lock_memory", this, &FreqShift_i::lock_memoryChanged);
+	addPropertyChangeListener("connectionTable", this, &FreqShift_i::connectionTableChanged);
+}
 
 FreqShift_i::~FreqShift_i()
 {
+	//Release any packets that were still waiting to be serviced
+	for(StreamContext *context = streams.leastRecent(); context; context = streams.newerThan(context))
+	{
+		StreamQueue &queue = context->queue;
+		for(size_t i=0;i<queue.size;i++)
+			releasePacket(queue.ring[(queue.head + i) % queue.ring.size()]);
+	}
+}
+
+void FreqShift_i::stream_prioritiesChanged(const std::vector<stream_priority_struct> *oldValue, const std::vector<stream_priority_struct> *newValue)
+{
+	map<string, short> table;
+	for(unsigned int i=0;i<newValue->size();i++)
+		table[(*newValue)[i].stream_id] = (*newValue)[i].priority;
+
+	boost::mutex::scoped_lock lock(priorityLock);
+	priorityTable.swap(table);
+}
+
+void FreqShift_i::default_priorityChanged(const short *oldValue, const short *newValue)
+{
+	boost::mutex::scoped_lock lock(priorityLock);
+	defaultPriority = *newValue;
+}
+
+//Streams compare the version against the one their channel rotations were worked out for, and
+//take a fresh copy of the shifts when it has moved on
+void FreqShift_i::channel_shiftsChanged(const std::vector<float> *oldValue, const std::vector<float> *newValue)
+{
+	boost::mutex::scoped_lock lock(channelLock);
+	channelShifts = *newValue;
+	channelShiftsVersion++;
+}
+
+//Entries naming a single stream go into a map; those with wildcards are kept in order and
+//only tried when no exact entry matches
+void FreqShift_i::stream_frequenciesChanged(const std::vector<stream_frequency_struct> *oldValue, const std::vector<stream_frequency_struct> *newValue)
+{
+	map<string, float> table;
+	vector<std::pair<string, float> > patterns;
+	for(unsigned int i=0;i<newValue->size();i++)
+	{
+		const stream_frequency_struct &entry = (*newValue)[i];
+		if(entry.stream_id.find_first_of("*?[") != string::npos)
+			patterns.push_back(std::make_pair(entry.stream_id, entry.frequency));
+		else
+			table[entry.stream_id] = entry.frequency;
+	}
+
+	boost::mutex::scoped_lock lock(frequencyLock);
+	frequencyTable.swap(table);
+	frequencyPatterns.swap(patterns);
+	frequencyOverridesVersion++;
+}
+
+void FreqShift_i::frequency_keywordChanged(const std::string *oldValue, const std::string *newValue)
+{
+	boost::mutex::scoped_lock lock(frequencyLock);
+	frequencyKeyword = *newValue;
+	frequencyOverridesVersion++;
+}
+
+//Placement can only be applied by the processing thread to itself, so changes are picked up
+//at the start of its next iteration
+void FreqShift_i::numa_nodeChanged(const CORBA::Long *oldValue, const CORBA::Long *newValue)
+{
+	boost::mutex::scoped_lock lock(placementLock);
+	numaNode = *newValue;
+	placementVersion++;
+}
+
+void FreqShift_i::cpu_affinityChanged(const std::string *oldValue, const std::string *newValue)
+{
+	boost::mutex::scoped_lock lock(placementLock);
+	cpuAffinity = *newValue;
+	placementVersion++;
+}
+
+void FreqShift_i::scheduling_policyChanged(const std::string *oldValue, const std::string *newValue)
+{
+	boost::mutex::scoped_lock lock(placementLock);
+	schedulingPolicy = *newValue;
+	placementVersion++;
+}
+
+void FreqShift_i::scheduling_priorityChanged(const short *oldValue, const short *newValue)
+{
+	boost::mutex::scoped_lock lock(placementLock);
+	schedulingPriority = *newValue;
+	placementVersion++;
+}
+
+void FreqShift_i::lock_memoryChanged(const bool *oldValue, const bool *newValue)
+{
+	boost::mutex::scoped_lock lock(placementLock);
+	lockMemory = *newValue;
+	placementVersion++;
+}
+
+//The output ports apply the filter themselves. The stream IDs each port lets through are
+//kept as well, so that streams no port would push need not be shifted
+void FreqShift_i::connectionTableChanged(const std::vector<connection_descriptor_struct> *oldValue, const std::vector<connection_descriptor_struct> *newValue)
+{
+	std::vector<bulkio::connection_descriptor_struct> filter(newValue->size());
+	map<string, std::set<string> > table;
+	for(unsigned int i=0;i<newValue->size();i++)
+	{
+		const connection_descriptor_struct &entry = (*newValue)[i];
+		filter[i].connection_id = entry.connection_id;
+		filter[i].stream_id = entry.stream_id;
+		filter[i].port_name = entry.port_name;
+		table[entry.port_name].insert(entry.stream_id);
+	}
+	dataFloat_out->updateConnectionFilter(filter);
+	dataShort_out->updateConnectionFilter(filter);
+	dataOctet_out->updateConnectionFilter(filter);
+	dataDouble_out->updateConnectionFilter(filter);
+
+	boost::mutex::scoped_lock lock(routingLock);
+	routingTable.swap(table);
+	connectionTableVersion++;
 }
 
 /***********************************************************************************************
@@ -163,76 +364,1013 @@ FreqShift_i::~FreqShift_i()
 ************************************************************************************************/
 int FreqShift_i::serviceFunction()
 {
-    bulkio::InFloatPort::dataTransfer *tmp = dataFloat_in->getPacket(bulkio::Const::BLOCKING);
-    if (not tmp) { // No data is available
-    	return NOOP;
+    //Everything from here on is the processing path, which should make no heap
+    //allocations once every stream has reached its high-water mark
+    AllocationCounter::Scope counting(true);
+
+    if(appliedPlacementVersion != placementVersion)
+    	applyPlacement();
+
+    publishWakeups();
+    fillSchedule();
+    ScratchArena::setHugePages(huge_page_scratch);
+
+    size_t budget = std::max<size_t>(batch_size, 1);
+    size_t serviced = 0;
+
+    while(serviced < budget)
+    {
+    	state = nextScheduled();
+    	if(!state)
+    		break;
+
+    	//Short packets of several streams are shifted together when cross-stream batching
+    	//is on; the chosen stream goes on by itself when that is not possible. A batch is
+    	//sized by cross_stream_lanes alone, and may take the iteration past batch_size
+    	if(cross_stream_lanes > 1)
+    	{
+    		size_t batched = serviceLanes();
+    		serviced += batched;
+    		if(batched)
+    			continue;
+    	}
+
+    	//Packets of the chosen stream are serviced back to back so that its phase and
+    	//rotation state stay in cache between packets
+    	bool EOS = false;
+    	while(serviced < budget && !state->queue.empty())
+    	{
+    		PendingPacket next = dequeue(*state);
+    		EOS = servicePacket(next);
+    		recordLatency(state->priority, next);
+    		serviced++;
+    	}
+
+    	//A stream's context is kept while the stream is active so that it can be reused,
+    	//and reclaimed once its end of stream has been serviced
+    	if(EOS && state->queue.empty())
+    		reclaim(state);
     }
 
-    map<string, complex<float> >::iterator current_value;
-    string ID = (string)tmp->SRI.streamID;
+    //An iteration with nothing to service has already waited on a port, spun or slept,
+    //which throttles the loop. Returning NOOP would add the thread delay on top, and a
+    //packet arriving meanwhile would wait for it rather than waking the thread
+    if (serviced == 0) { // No data is available
+    	return NORMAL;
+    }
 
-    current_value = phasor_map.find(ID);
+    publishStatus();
+    return NORMAL;
+}
 
-    if(current_value != phasor_map.end())
-    	phasor = &current_value->second;
-    else
-    	phasor_map[ID] = complex<float>(1,0);
-    	current_value = phasor_map.find(ID);
-    	phasor = &current_value->second;
+//Pulls packets off the input ports into the per-stream queues until scheduler_depth (or
+//batch_size, if larger) packets are waiting. Only waits on a port when there is nothing
+//left to service, and then only until held coalesced output is due
+void FreqShift_i::fillSchedule()
+{
+    size_t depth = std::max<size_t>(std::max<size_t>(scheduler_depth, batch_size), 1);
+
+    //Held output is checked on every iteration, so that a stream that has gone quiet is
+    //flushed on time even while other streams keep packets waiting
+    float untilFlush = flushOverdue();
+
+    //With nothing waiting, the port that last delivered a packet is waited on, but only for
+    //INPUT_POLL_INTERVAL so that a stream starting on another port is not held up
+    if(!pendingCount)
+    {
+    	float timeout = INPUT_POLL_INTERVAL;
+    	if(untilFlush >= 0)
+    		timeout = std::min(timeout, std::max(untilFlush, 0.001f));
+
+    	//In idle mode the thread sleeps until a batch of packets has built up instead
+    	if(idle_wakeup_packets)
+    	{
+    		idleWait(untilFlush);
+    	}
+    	else
+    	{
+    		//In busy-poll mode every port is polled for up to spin_budget first, so that a packet
+    		//arriving meanwhile is taken without waking the thread; the wait on a port follows
+    		//only when the budget runs out
+    		float spin = spin_budget/1e6;
+    		if(untilFlush >= 0)
+    			spin = std::min(spin, untilFlush);
+    		if(spin <= 0 || !spinForPacket(spin))
+    		{
+    			switch(lastInput)
+    			{
+    			case ShiftKernel::SHORT_INPUT:
+    				takePacket(dataShort_in, ShiftKernel::SHORT_INPUT, timeout);
+    				break;
+    			case ShiftKernel::OCTET_INPUT:
+    				takePacket(dataOctet_in, ShiftKernel::OCTET_INPUT, timeout);
+    				break;
+    			case ShiftKernel::DOUBLE_INPUT:
+    				takePacket(dataDouble_in, ShiftKernel::DOUBLE_INPUT, timeout);
+    				break;
+    			default:
+    				takePacket(dataFloat_in, ShiftKernel::FLOAT_INPUT, timeout);
+    				break;
+    			}
+    			wakeups++;
+    		}
+    	}
+    }
+
+    //The ports are then drained a packet at a time in turn, so that none can starve the others
+    while(pendingCount < depth && pollInputs())
+    	;
+}
+
+//Takes at most one packet off each input port without blocking, returning whether any
+//were waiting
+bool FreqShift_i::pollInputs()
+{
+    bool received = takePacket(dataFloat_in, ShiftKernel::FLOAT_INPUT, bulkio::Const::NON_BLOCKING);
+    received |= takePacket(dataShort_in, ShiftKernel::SHORT_INPUT, bulkio::Const::NON_BLOCKING);
+    received |= takePacket(dataOctet_in, ShiftKernel::OCTET_INPUT, bulkio::Const::NON_BLOCKING);
+    received |= takePacket(dataDouble_in, ShiftKernel::DOUBLE_INPUT, bulkio::Const::NON_BLOCKING);
+    return received;
+}
 
-    vector<float> *output;	//pointer to output data
-    vector<complex<float> > complex_vector;
-    complex_vector.resize(tmp->dataBuffer.size());
+//Polls the input ports until a packet arrives or limit seconds have passed. Empty polls
+//are followed by a pause that doubles each time, up to spin_pause_limit pause instructions
+bool FreqShift_i::spinForPacket(float limit)
+{
+    boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() +
+    		boost::posix_time::microseconds((long)(limit*1e6));
+    size_t pauses = 1;
+    while(!pollInputs())
+    {
+    	if(boost::posix_time::microsec_clock::universal_time() >= deadline)
+    		return false;
+    	for(size_t i = std::min<size_t>(pauses, spin_pause_limit); i > 0; i--)
+    		spinPause();
+    	pauses = std::min<size_t>(pauses*2, std::max<size_t>(spin_pause_limit, 1));
+    }
+    return true;
+}
+
+//Sleeps, off the input ports so that arriving packets do not wake the thread, until
+//idle_wakeup_packets are expected to be queued at the rate packets have been arriving, or
+//until idle_wakeup_delay (or held coalesced output) is due, whichever comes first
+void FreqShift_i::idleWait(float untilFlush)
+{
+    float delay = idle_wakeup_delay/1000.0;
+    if(untilFlush >= 0)
+    	delay = std::min(delay, untilFlush);
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    boost::posix_time::ptime deadline = now + boost::posix_time::microseconds((long)(std::max(delay, 0.001f)*1e6));
 
+    size_t queued = queuedPackets();
+    while(queued < idle_wakeup_packets && now < deadline)
+    {
+    	boost::posix_time::ptime wake = deadline;
+    	if(packetRate > 0)
+    		wake = std::min(wake, now + boost::posix_time::microseconds((long)((idle_wakeup_packets - queued)/packetRate*1e6)));
+    	boost::this_thread::sleep(wake - now);
+    	wakeups++;
 
-    complex<float> deltaTheta(cos(2*M_PI*frequency_shift*tmp->SRI.xdelta), sin(2*M_PI*frequency_shift*tmp->SRI.xdelta));
+    	//The arrival rate is measured over each sleep, when nothing else takes packets
+    	boost::posix_time::ptime asleep = now;
+    	now = boost::posix_time::microsec_clock::universal_time();
+    	size_t arrived = queuedPackets();
+    	double seconds = (now - asleep).total_microseconds()/1e6;
+    	if(seconds > 0)
+    	{
+    		double rate = (arrived > queued ? arrived - queued : 0)/seconds;
+    		packetRate = packetRate > 0 ? 0.75*packetRate + 0.25*rate : rate;
+    	}
+    	queued = arrived;
+    }
+}
 
-    //Generates a vector which stores to the real and imaginary parts of a complex exponential
-    //containing the desired amount by which the frequency is to be shifted
-    for(unsigned int i=0;i<tmp->dataBuffer.size();i++)
+//Number of packets waiting on all of the input ports
+size_t FreqShift_i::queuedPackets()
+{
+    return dataFloat_in->getCurrentQueueDepth() + dataShort_in->getCurrentQueueDepth() +
+    		dataOctet_in->getCurrentQueueDepth() + dataDouble_in->getCurrentQueueDepth();
+}
+
+//Publishes wakeups_per_second about once a second
+void FreqShift_i::publishWakeups()
+{
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    if(wakeupWindow.is_not_a_date_time())
+    	wakeupWindow = now;
+    double seconds = (now - wakeupWindow).total_microseconds()/1e6;
+    if(seconds < 1.0)
+    	return;
+
+    boost::mutex::scoped_lock lock(propertySetAccess);
+    wakeups_per_second = wakeups/seconds;
+    wakeups = 0;
+    wakeupWindow = now;
+}
+
+//Takes a packet off an input port, if one arrives within timeout, and queues it behind
+//the other waiting packets of its stream
+template<typename Port>
+bool FreqShift_i::takePacket(Port *port, ShiftKernel::InputFormat format, float timeout)
+{
+    typename Port::dataTransfer *tmp;
     {
-    	complex_vector[i] = *phasor;
-    	*phasor = *phasor*deltaTheta;
+    	AllocationCounter::Scope paused(false);
+    	tmp = port->getPacket(timeout);
     }
+    if (not tmp)
+    	return false;
 
-	*phasor = *phasor/abs(*phasor);
+    PendingPacket entry;
+    entry.format = format;
+    entry.packet = tmp;
+    entry.arrival = boost::posix_time::microsec_clock::universal_time();
+    lastInput = format;
 
-    //If signal is complex, takes the product of input and complex vector and stores result in data
-    //Shifts the frequency by frequency_shift Hz
-    if(COMPLEX)
+    //A stream's priority is looked up again whenever it starts waiting afresh, so that
+    //changes to stream_priorities take effect between bursts
+    StreamContext *context = contextFor(tmp->streamID);
+    if(context->queue.empty())
     {
-    	vector<complex<float> > *input = (vector<complex<float> > *)&tmp->dataBuffer;
-    	vectormultiply(*input, complex_vector, shiftedSignal);
+    	context->priority = priorityOf(tmp->streamID);
+    	context->waitingSlot = waitingStreams.size();
+    	waitingStreams.push_back(context);
     }
+    context->queue.push_back(entry);
+    pendingCount++;
+    return true;
+}
 
-    //If signal is purely real, takes the product of input and complex vector and stores result in data
-    //Shifts the frequency by frequency_shift Hz
-    else
+//Processes and releases a waiting packet of the stream being serviced, returning whether
+//it ended the stream
+bool FreqShift_i::servicePacket(const PendingPacket &entry)
+{
+    bool EOS;
+    switch(entry.format)
     {
-    	vector<float> *input = (vector<float> *)&tmp->dataBuffer;
-    	vectormultiply(*input, complex_vector, shiftedSignal);
+    case ShiftKernel::SHORT_INPUT:
+    	EOS = static_cast<bulkio::InShortPort::dataTransfer *>(entry.packet)->EOS;
+    	processPacket(static_cast<bulkio::InShortPort::dataTransfer *>(entry.packet), entry.format);
+    	break;
+    case ShiftKernel::OCTET_INPUT:
+    	EOS = static_cast<bulkio::InOctetPort::dataTransfer *>(entry.packet)->EOS;
+    	processPacket(static_cast<bulkio::InOctetPort::dataTransfer *>(entry.packet), entry.format);
+    	break;
+    case ShiftKernel::DOUBLE_INPUT:
+    	EOS = static_cast<bulkio::InDoublePort::dataTransfer *>(entry.packet)->EOS;
+    	processPacket(static_cast<bulkio::InDoublePort::dataTransfer *>(entry.packet), entry.format);
+    	break;
+    default:
+    	EOS = static_cast<bulkio::InFloatPort::dataTransfer *>(entry.packet)->EOS;
+    	processPacket(static_cast<bulkio::InFloatPort::dataTransfer *>(entry.packet), entry.format);
+    	break;
     }
-    output = &shiftedSignal;
 
-    //If this is the first time the service function is run, set mode equal to 1
-    //for complex and push SRI. This only runs the first iteration, as the output data
-    //will always be complex
-    if(firstTime)
+    releasePacket(entry); // IMPORTANT: MUST RELEASE THE RECEIVED DATA BLOCK
+    return EOS;
+}
+
+void FreqShift_i::releasePacket(const PendingPacket &entry)
+{
+    switch(entry.format)
     {
-        tmp->SRI.mode = 1;
-    	dataFloat_out->pushSRI(tmp->SRI);
-    	firstTime = false;
+    case ShiftKernel::SHORT_INPUT:
+    	delete static_cast<bulkio::InShortPort::dataTransfer *>(entry.packet);
+    	break;
+    case ShiftKernel::OCTET_INPUT:
+    	delete static_cast<bulkio::InOctetPort::dataTransfer *>(entry.packet);
+    	break;
+    case ShiftKernel::DOUBLE_INPUT:
+    	delete static_cast<bulkio::InDoublePort::dataTransfer *>(entry.packet);
+    	break;
+    default:
+    	delete static_cast<bulkio::InFloatPort::dataTransfer *>(entry.packet);
+    	break;
+    }
+}
+
+//Chooses the stream to service next: the highest priority stream with packets waiting,
+//unless some packet has waited longer than starvation_limit, in which case the stream
+//holding the oldest waiting packet goes first regardless of its priority. Only streams
+//with packets waiting are looked at, however many idle streams are being kept
+FreqShift_i::StreamContext *FreqShift_i::nextScheduled()
+{
+    StreamContext *best = NULL;
+    StreamContext *oldest = NULL;
+
+    for(size_t i=0;i<waitingStreams.size();i++)
+    {
+    	StreamContext *context = waitingStreams[i];
+    	const boost::posix_time::ptime &arrival = context->queue.front().arrival;
+    	if(!best || context->priority > best->priority ||
+    			(context->priority == best->priority && arrival < best->queue.front().arrival))
+    		best = context;
+    	if(!oldest || arrival < oldest->queue.front().arrival)
+    		oldest = context;
     }
 
-    if (tmp->sriChanged || (dataFloat_out->getCurrentSRI().count(tmp->streamID)==0))
+    if(!best)
+    	return NULL;
+
+    boost::posix_time::time_duration waited = boost::posix_time::microsec_clock::universal_time() - oldest->queue.front().arrival;
+    if(waited.total_microseconds() > starvation_limit*1000.0)
+    	best = oldest;
+
+    return best;
+}
+
+//Takes the next waiting packet of a stream off its queue. A stream whose queue empties
+//leaves waitingStreams, its place taken by the last stream in it
+FreqShift_i::PendingPacket FreqShift_i::dequeue(StreamContext &stream)
+{
+    PendingPacket next = stream.queue.front();
+    stream.queue.pop_front();
+    pendingCount--;
+
+    if(stream.queue.empty())
+    {
+    	StreamContext *last = waitingStreams.back();
+    	waitingStreams[stream.waitingSlot] = last;
+    	last->waitingSlot = stream.waitingSlot;
+    	waitingStreams.pop_back();
+    }
+    return next;
+}
+
+//Services the next packet of the scheduled stream together with the next packets of up to
+//cross_stream_lanes - 1 other streams, one lane per stream. Returns the number of packets
+//serviced, which is 0 when fewer than two streams have a packet that can go in a lane
+size_t FreqShift_i::serviceLanes()
+{
+    //Lanes only produce float output
+    if(dataFloat_out->state() == BULKIO::IDLE || dataShort_out->state() != BULKIO::IDLE || dataOctet_out->state() != BULKIO::IDLE ||
+    		dataDouble_out->state() != BULKIO::IDLE || !laneEligible(*state))
+    	return 0;
+
+    size_t width = std::min<size_t>(cross_stream_lanes, LaneShifter::LANES);
+    StreamContext *members[LaneShifter::LANES];
+    size_t count = 0;
+    members[count++] = state;
+    for(size_t i=0;i<waitingStreams.size() && count < width;i++)
+    {
+    	StreamContext *context = waitingStreams[i];
+    	if(context != state && laneEligible(*context))
+    		members[count++] = context;
+    }
+    if(count < 2)
+    	return 0;
+
+    //Complex packets are shifted in place; real packets are widened into their stream's scratch
+    LaneShifter::Lane lanes[LaneShifter::LANES];
+    size_t longest = 0;
+    for(size_t l=0;l<count;l++)
+    {
+    	StreamContext &stream = *members[l];
+    	bulkio::InFloatPort::dataTransfer *tmp = static_cast<bulkio::InFloatPort::dataTransfer *>(stream.queue.front().packet);
+    	LaneShifter::Lane &lane = lanes[l];
+    	lane.complexInput = tmp->SRI.mode;
+    	lane.count = tmp->dataBuffer.size()/(lane.complexInput ? 2 : 1);
+    	lane.input = &tmp->dataBuffer[0];
+    	lane.phasor = stream.phasor;
+    	lane.deltaTheta = stream.deltaTheta;
+    	if(lane.complexInput)
+    		lane.output = (complex<float> *)&tmp->dataBuffer[0];
+    	else
+    		lane.output = stream.scratch.get<complex<float> >(OUTPUT_SCRATCH, lane.count);
+    	longest = std::max(longest, lane.count);
+    }
+    LaneShifter::process(lanes, count, laneScratch.get<float>(0, LaneShifter::scratchSize(longest)));
+
+    for(size_t l=0;l<count;l++)
+    {
+    	state = members[l];
+    	PendingPacket next = dequeue(*state);
+
+    	bulkio::InFloatPort::dataTransfer *tmp = static_cast<bulkio::InFloatPort::dataTransfer *>(next.packet);
+    	size_t samples = lanes[l].count;
+    	size_t target = coalesceTarget(*state, samples);
+    	if(max_output_packet_size && target)
+    		target = std::min<size_t>(target, max_output_packet_size);
+
+    	advancePhase(*state, samples);
+    	deliver(tmp->T, tmp->SRI.xdelta, false, (const float *)lanes[l].output, 2*samples, target);
+    	recordLatency(state->priority, next);
+    	releasePacket(next);
+    }
+    return count;
+}
+
+//Whether the next packet of a stream can be shifted in a lane: a short, non-empty packet on
+//dataFloat_in whose stream is not framed and whose SRI, rotation and output SRI are already
+//in place, so that the packet needs nothing but the shift itself. End of stream goes through
+//processPacket, which passes it on to every output port that has seen the stream
+bool FreqShift_i::laneEligible(const StreamContext &stream)
+{
+    if(stream.queue.empty())
+    	return false;
+    const PendingPacket &entry = stream.queue.ring[stream.queue.head];
+    if(entry.format != ShiftKernel::FLOAT_INPUT)
+    	return false;
+
+    const bulkio::InFloatPort::dataTransfer *tmp = static_cast<const bulkio::InFloatPort::dataTransfer *>(entry.packet);
+    size_t samples = tmp->dataBuffer.size()/(tmp->SRI.mode ? 2 : 1);
+    float shift = stream.frequencyOverridden ? stream.overrideFrequency : frequency_shift;
+    return samples > 0 && samples <= cross_stream_packet_limit &&
+    		(!max_output_packet_size || samples <= max_output_packet_size) &&
+    		!tmp->sriChanged && !tmp->inputQueueFlushed && !tmp->EOS && stream.sriPushed &&
+    		stream.kernel[ShiftKernel::FLOAT_OUTPUT] && stream.format == ShiftKernel::FLOAT_INPUT &&
+    		stream.channels == 1 && stream.xdelta == tmp->SRI.xdelta && stream.frequency == shift &&
+    		stream.frequencyOverridesVersion == frequencyOverridesVersion &&
+    		stream.routingVersion == connectionTableVersion && stream.routed[ShiftKernel::FLOAT_OUTPUT];
+}
+
+//Returns the context for a stream, creating it if the stream is new. When max_streams
+//contexts already exist, the least recently used stream with no packets waiting is
+//evicted to make room; its held output is pushed and its phase is forgotten
+FreqShift_i::StreamContext *FreqShift_i::contextFor(const string &streamID)
+{
+    StreamContext *context = streams.find(streamID);
+    if(context)
+    	return context;
+
+    if(max_streams && streams.size() >= max_streams)
+    {
+    	StreamContext *victim = streams.leastRecent();
+    	while(victim && !victim->queue.empty())
+    		victim = streams.newerThan(victim);
+
+    	if(victim)
+    	{
+    		LOG_DEBUG(FreqShift_i, "Evicting state for stream " << victim->streamID);
+    		reclaim(victim);
+    	}
+    }
+
+    return streams.insert(streamID);
+}
+
+//Pushes anything a stream still holds and destroys its context
+void FreqShift_i::reclaim(StreamContext *context)
+{
+    flushCoalesced(*context, false);
+    if(state == context)
+    	state = NULL;
+    streams.erase(context);
+}
+
+void FreqShift_i::StreamQueue::push_back(const PendingPacket &entry)
+{
+    //When the ring is full it is doubled, unrolling the waiting packets to its start
+    if(size == ring.size())
+    {
+    	vector<PendingPacket> grown(std::max<size_t>(2*ring.size(), 4));
+    	for(size_t i=0;i<size;i++)
+    		grown[i] = ring[(head + i) % ring.size()];
+    	ring.swap(grown);
+    	head = 0;
+    }
+    ring[(head + size) % ring.size()] = entry;
+    size++;
+}
+
+short FreqShift_i::priorityOf(const string &streamID)
+{
+    boost::mutex::scoped_lock lock(priorityLock);
+    map<string, short>::const_iterator it = priorityTable.find(streamID);
+    return (it != priorityTable.end()) ? it->second : defaultPriority;
+}
+
+//Adds the latency of a serviced packet to its priority class
+void FreqShift_i::recordLatency(short priority, const PendingPacket &serviced)
+{
+    boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - serviced.arrival;
+    double latency = elapsed.total_microseconds()/1000.0;
+
+    LatencyStats &stats = latencyStats[priority];
+    stats.packets++;
+    stats.total += latency;
+    stats.max = std::max(stats.max, latency);
+}
+
+//Publishes the per-class latency totals through the priority_latency property, along
+//with the scratch memory in use and the allocations counted on the processing path
+void FreqShift_i::publishStatus()
+{
+    boost::mutex::scoped_lock lock(propertySetAccess);
+    scratch_bytes = ScratchArena::totalBytes();
+    huge_pages = ScratchArena::totalHugePages();
+    active_streams = streams.size();
+    hot_path_allocations = AllocationCounter::count();
+
+    priority_latency.resize(latencyStats.size());
+    unsigned int i = 0;
+    for(map<short, LatencyStats>::const_iterator it = latencyStats.begin(); it != latencyStats.end(); ++it, ++i)
+    {
+    	priority_latency[i].priority = it->first;
+    	priority_latency[i].packets = it->second.packets;
+    	priority_latency[i].average_latency = it->second.total/it->second.packets;
+    	priority_latency[i].max_latency = it->second.max;
+    }
+}
+
+//Binds the processing thread to cpu_affinity, or to the CPUs of numa_node, makes numa_node
+//the preferred node for memory the thread touches first, and sets the thread's scheduling.
+//When the node or CPUs change, scratch buffers are released, once any output they hold has
+//been pushed, so that they grow again under the new placement. With lock_memory, all of the
+//process's memory is locked, which faults in every page it has mapped, scratch included, and
+//every page it maps later as it is allocated; the thread's stack is faulted in as well. This
+//runs at the start of the first iteration after every start(), and again whenever one of the
+//properties changes
+void FreqShift_i::applyPlacement()
+{
+    AllocationCounter::Scope paused(false);
+
+    int node;
+    string cpus;
+    string policy;
+    short priority;
+    bool locking;
+    {
+    	boost::mutex::scoped_lock lock(placementLock);
+    	node = numaNode;
+    	cpus = cpuAffinity;
+    	policy = schedulingPolicy;
+    	priority = schedulingPriority;
+    	locking = lockMemory;
+    	appliedPlacementVersion = placementVersion;
+    }
+
+    //A thread that was bound earlier is freed again when neither property names any CPUs;
+    //one that never was is left with the affinity it inherited from the process
+    if(cpus.empty() && node >= 0)
+    	cpus = ThreadPlacement::nodeCpus(node);
+    if(cpus.empty() && threadBound)
+    	cpus = ThreadPlacement::allCpus();
+    if(!cpus.empty())
+    {
+    	threadBound = ThreadPlacement::bindCpus(cpus);
+    	if(!threadBound)
+    		LOG_WARN(FreqShift_i, "Unable to bind the processing thread to cpus " << cpus);
+    }
+
+    //The memory policy and scheduling are handled the same way: those inherited from the
+    //process (numactl, chrt) are kept until numa_node or scheduling_policy is set, and only a
+    //policy set here is reset to the default once the property is cleared again
+    if(node >= 0 || memoryPolicySet)
+    {
+    	if(ThreadPlacement::preferNode(node))
+    		memoryPolicySet = (node >= 0);
+    	else
+    		LOG_WARN(FreqShift_i, "Unable to place memory on NUMA node " << node);
+    }
+    if(policy != "SCHED_OTHER" || threadScheduled)
+    {
+    	if(ThreadPlacement::setScheduling(policy, priority))
+    		threadScheduled = (policy != "SCHED_OTHER");
+    	else
+    		LOG_WARN(FreqShift_i, "Unable to set scheduling of the processing thread to " << policy << " priority " << priority);
+    }
+
+    if(node != placedNode || cpus != placedCpus)
+    {
+    	for(StreamContext *context = streams.leastRecent(); context; context = streams.newerThan(context))
+    	{
+    		flushCoalesced(*context, false);
+    		context->scratch.release();
+    	}
+    	laneScratch.release();
+    	placedNode = node;
+    	placedCpus = cpus;
+    }
+
+    if(locking != memoryLocked)
+    {
+    	if(ThreadPlacement::lockMemory(locking))
+    		memoryLocked = locking;
+    	else
+    		LOG_WARN(FreqShift_i, "Unable to " << (locking ? "lock" : "unlock") << " memory");
+    }
+    if(memoryLocked)
+    	ThreadPlacement::prefaultStack(STACK_PREFAULT);
+
+    string description = ThreadPlacement::describe();
+    boost::mutex::scoped_lock lock(propertySetAccess);
+    placement = description;
+}
+
+//Shifts one received packet of the stream being serviced and delivers the output. Packet
+//is the dataTransfer type of the port given by format
+template<typename Packet>
+void FreqShift_i::processPacket(Packet *tmp, ShiftKernel::InputFormat format)
+{
+    //Input is framed when its subsize is greater than 1: each frame holds one sample from each
+    //of subsize channels, and frames are ydelta apart, or xdelta apart when ydelta is not set
+    const size_t channels = (tmp->SRI.subsize > 1) ? tmp->SRI.subsize : 1;
+    const double period = (channels > 1 && tmp->SRI.ydelta > 0) ? tmp->SRI.ydelta : tmp->SRI.xdelta;
+
+    //Whether the stream's shift is overridden is only looked up for its first packet and when
+    //its SRI or the overrides change
+    if(tmp->sriChanged || !state->kernel[ShiftKernel::FLOAT_OUTPUT] || state->frequencyOverridesVersion != frequencyOverridesVersion)
+    	resolveFrequency(*state, tmp->SRI);
+    const float shift = state->frequencyOverridden ? state->overrideFrequency : frequency_shift;
+
+    //The per-sample rotation, and the kernel that applies it, are only chosen again when the
+    //shift, the sample rate or the input port or mode changes. Nothing below branches on any
+    //of them
+    if(tmp->sriChanged || !state->kernel[ShiftKernel::FLOAT_OUTPUT] || state->format != format ||
+    		state->frequency != shift || state->xdelta != period || state->channels != channels ||
+    		(channels > 1 && state->channelShiftsVersion != channelShiftsVersion))
+    {
+    	state->format = format;
+    	state->frequency = shift;
+    	state->xdelta = period;
+    	state->deltaTheta = complex<double>(cos(2*M_PI*shift*period), sin(2*M_PI*shift*period));
+    	for(int output=0;output<ShiftKernel::OUTPUT_FORMATS;output++)
+    		state->kernel[output] = ShiftKernel::select(format, COMPLEX, ShiftKernel::OutputFormat(output), shift*period);
+    	state->channels = channels;
+    	if(channels > 1)
+    		resolveChannelShifts(*state);
+    }
+    const ShiftKernel &kernel = *state->kernel[ShiftKernel::FLOAT_OUTPUT];
+
+    const size_t elementSize = sizeof(tmp->dataBuffer[0]);
+    const size_t samples = tmp->dataBuffer.size()*elementSize/kernel.inputSize;
+
+    //The output is always complex, so the mode of every SRI pushed is set to 1. Whether a
+    //stream's SRI has gone out is kept in its context, so the output port's SRI table does
+    //not have to be copied and searched for every packet
+    if(tmp->sriChanged || !state->sriPushed)
+    {
+    	AllocationCounter::Scope paused(false);
+
+    	//Samples held for coalescing were produced under the previous SRI and must go out first
+    	flushCoalesced(*state, false);
+    	tmp->SRI.mode = 1;
     	dataFloat_out->pushSRI(tmp->SRI);
+    	dataShort_out->pushSRI(tmp->SRI);
+    	dataOctet_out->pushSRI(tmp->SRI);
+    	dataDouble_out->pushSRI(tmp->SRI);
+    	state->sriPushed = true;
+    }
 
     if(tmp->inputQueueFlushed)
     	LOG_WARN(FreqShift_i, "WARNING - Input Queue Flushed");
 
-    dataFloat_out->pushPacket(*output, tmp->T, tmp->EOS, tmp->streamID);
+    //Large packets are shifted and pushed max_output_packet_size samples at a time, so that
+    //downstream receives the first samples sooner and only one chunk of output is in memory.
+    //Framed input is split on frame boundaries
+    size_t chunk = samples;
+    size_t target = coalesceTarget(*state, samples);
+    if(max_output_packet_size)
+    {
+    	chunk = std::min<size_t>(chunk, std::max<size_t>(max_output_packet_size/channels, 1)*channels);
+    	if(target)
+    		target = std::min<size_t>(target, max_output_packet_size);
+    }
+
+    //Time between output samples; samples within a frame are spread evenly over the frame
+    const double sampleTime = period/channels;
 
-    delete tmp; // IMPORTANT: MUST RELEASE THE RECEIVED DATA BLOCK
-    return NORMAL;
+    //Output is only computed for the ports that have connections and whose connection filter
+    //lets the stream through
+    if(state->routingVersion != connectionTableVersion)
+    	resolveRouting(*state);
+    const bool floatWanted = state->routed[ShiftKernel::FLOAT_OUTPUT] && dataFloat_out->state() != BULKIO::IDLE;
+    const bool shortWanted = state->routed[ShiftKernel::SHORT_OUTPUT] && dataShort_out->state() != BULKIO::IDLE;
+    const bool octetWanted = state->routed[ShiftKernel::OCTET_OUTPUT] && dataOctet_out->state() != BULKIO::IDLE;
+    const bool doubleWanted = state->routed[ShiftKernel::DOUBLE_OUTPUT] && dataDouble_out->state() != BULKIO::IDLE;
+
+    char *input = tmp->dataBuffer.empty() ? NULL : (char *)&tmp->dataBuffer[0];
+    state->scratch.setShrink(shrink_scratch);
+
+    //Streams that no port would push are not shifted at all. Their samples are only counted,
+    //so that the phase carries on from the right place should they be pushed again
+    if(!floatWanted && !shortWanted && !octetWanted && !doubleWanted)
+    	advancePhase(*state, samples);
+    else
+    {
+    	size_t offset = 0;
+    	do
+    	{
+    		size_t count = std::min(chunk, samples - offset);
+    		char *in = input + offset*kernel.inputSize;
+
+    		//The other outputs go first, since the float output may be written over the input
+    		if(shortWanted || octetWanted || doubleWanted)
+    		{
+    			BULKIO::PrecisionUTCTime T = advanceTime(tmp->T, offset*sampleTime);
+    			bool EOS = tmp->EOS && offset + count == samples;
+    			if(shortWanted)
+    				pushConverted<short>(dataShort_out, *state->kernel[ShiftKernel::SHORT_OUTPUT], in, count, T, EOS);
+    			if(octetWanted)
+    				pushConverted<unsigned char>(dataOctet_out, *state->kernel[ShiftKernel::OCTET_OUTPUT], in, count, T, EOS);
+    			if(doubleWanted)
+    				pushConverted<double>(dataDouble_out, *state->kernel[ShiftKernel::DOUBLE_OUTPUT], in, count, T, EOS);
+    		}
+
+    		//The float output is only shifted when it goes somewhere, but the phase moves on regardless
+    		void *output = NULL;
+    		if(floatWanted)
+    		{
+    			//Output no wider than the input is written back over the input samples and pushed
+    			//straight from the received buffer. Framed input is only shifted in place when the
+    			//output is the same size, since it is not shifted in strict sample order
+    			if(kernel.outputSize == kernel.inputSize || (kernel.outputSize < kernel.inputSize && channels == 1))
+    				output = in;
+
+    			//Wider output is shifted into the stream's output scratch a chunk at a time, just
+    			//before it is pushed, so that only one chunk of output is held at a time
+    			else
+    				output = state->scratch.get<complex<float> >(OUTPUT_SCRATCH, count);
+
+    			shiftSamples(kernel, in, count, 1, output);
+    		}
+    		advancePhase(*state, count);
+
+    		offset += count;
+    		if(floatWanted)
+    			deliver(advanceTime(tmp->T, (offset - count)*sampleTime), sampleTime,
+    					tmp->EOS && offset == samples, (const float *)output, count*2, target);
+    	} while(offset < samples);
+    }
+
+    //Ports the stream did not go out on are still told it has ended, so that they forget its
+    //SRI. The output ports forget a stream's SRI at end of stream, so it must be pushed again
+    //if more packets with the same stream ID follow
+    if(tmp->EOS)
+    {
+    	AllocationCounter::Scope paused(false);
+    	if(!floatWanted)
+    	{
+    		flushCoalesced(*state, false);
+    		dataFloat_out->pushPacket((const float *)NULL, 0, tmp->T, true, state->streamID);
+    	}
+    	if(!shortWanted)
+    		dataShort_out->pushPacket((const short *)NULL, 0, tmp->T, true, state->streamID);
+    	if(!octetWanted)
+    		dataOctet_out->pushPacket((const unsigned char *)NULL, 0, tmp->T, true, state->streamID);
+    	if(!doubleWanted)
+    		dataDouble_out->pushPacket((const double *)NULL, 0, tmp->T, true, state->streamID);
+    	state->sriPushed = false;
+    }
+}
+
+//Shifts count samples from in to the complex output of one of the ports other than
+//dataFloat_out, whose elements are Element, and pushes them on port. Integer output is
+//scaled by output_scale
+template<typename Element, typename Port>
+void FreqShift_i::pushConverted(Port *port, const ShiftKernel &kernel, const char *in, size_t count,
+		const BULKIO::PrecisionUTCTime &T, bool EOS)
+{
+    Element *output = state->scratch.get<Element>(CONVERTED_SCRATCH, 2*count);
+    shiftSamples(kernel, in, count, output_scale, output);
+
+    AllocationCounter::Scope paused(false);
+    port->pushPacket(output, 2*count, T, EOS, state->streamID);
+}
+
+//Shifts count samples of the stream being serviced from in to output, starting from the
+//stream's current phase. The phase is left where it was, so that every output port starts
+//from the same phase; advancePhase moves it on once they are all done. Blocks of at least
+//streaming_threshold samples go through the streaming kernel
+void FreqShift_i::shiftSamples(const ShiftKernel &kernel, const char *in, size_t count, float outputScale, void *output)
+{
+    if(state->channels > 1)
+    	kernel.processFramed(in, count, state->channels, input_scale, outputScale,
+    			&state->channelPhasors[0], &state->channelDeltas[0], output);
+    else
+    {
+    	complex<double> start = state->phasor;
+    	if(streaming_threshold && count >= streaming_threshold)
+    		kernel.processStreaming(in, count, input_scale, outputScale, start, state->deltaTheta, output);
+    	else
+    		kernel.process(in, count, input_scale, outputScale, start, state->deltaTheta, output);
+    }
+}
+
+//The stream's phase is carried forward in double precision, whatever precision the kernels
+//ran in, so that the double output keeps its accuracy across chunks. Each channel of framed
+//input moves on by the number of its samples among the count shifted
+void FreqShift_i::advancePhase(StreamContext &stream, size_t count)
+{
+    if(stream.channels > 1)
+    {
+    	size_t frames = count/stream.channels;
+    	size_t partial = count%stream.channels;
+    	for(size_t c=0;c<stream.channels;c++)
+    	{
+    		complex<double> &current = stream.channelPhasors[c];
+    		current *= unitpower(stream.channelDeltas[c], frames + (c < partial ? 1 : 0));
+    		current /= abs(current);
+    	}
+    }
+    else
+    {
+    	stream.phasor *= unitpower(stream.deltaTheta, count);
+    	stream.phasor /= abs(stream.phasor);
+    }
+}
+
+//Works out the shift of a stream from, in order, the frequency_keyword keyword of its SRI,
+//an exact stream_frequencies entry and the first stream_frequencies pattern it matches.
+//Streams matching none of them follow frequency_shift
+void FreqShift_i::resolveFrequency(StreamContext &stream, const BULKIO::StreamSRI &sri)
+{
+    boost::mutex::scoped_lock lock(frequencyLock);
+    stream.frequencyOverridesVersion = frequencyOverridesVersion;
+    stream.frequencyOverridden = true;
+
+    double value;
+    if(!frequencyKeyword.empty() && numericKeyword(sri.keywords, frequencyKeyword, value))
+    {
+    	stream.overrideFrequency = value;
+    	return;
+    }
+
+    map<string, float>::const_iterator it = frequencyTable.find(stream.streamID);
+    if(it != frequencyTable.end())
+    {
+    	stream.overrideFrequency = it->second;
+    	return;
+    }
+
+    for(unsigned int i=0;i<frequencyPatterns.size();i++)
+    {
+    	if(fnmatch(frequencyPatterns[i].first.c_str(), stream.streamID.c_str(), 0) == 0)
+    	{
+    		stream.overrideFrequency = frequencyPatterns[i].second;
+    		return;
+    	}
+    }
+
+    stream.frequencyOverridden = false;
+}
+
+//Works out the rotation for each channel of the stream's framed input from channel_shifts and
+//the frame period. Channels that were already running keep their phase
+void FreqShift_i::resolveChannelShifts(StreamContext &stream)
+{
+    AllocationCounter::Scope paused(false);
+    stream.channelPhasors.resize(stream.channels, complex<double>(1,0));
+    stream.channelDeltas.resize(stream.channels);
+
+    boost::mutex::scoped_lock lock(channelLock);
+    stream.channelShiftsVersion = channelShiftsVersion;
+    for(size_t c=0;c<stream.channels;c++)
+    {
+    	double shift = (c < channelShifts.size()) ? channelShifts[c] : stream.frequency;
+    	stream.channelDeltas[c] = complex<double>(cos(2*M_PI*shift*stream.xdelta), sin(2*M_PI*shift*stream.xdelta));
+    }
+}
+
+//Works out which output ports the connection filter lets the stream through to. Ports that
+//connectionTable has no entries for let every stream through
+void FreqShift_i::resolveRouting(StreamContext &stream)
+{
+    static const char *ports[ShiftKernel::OUTPUT_FORMATS] = {"dataFloat_out", "dataShort_out", "dataOctet_out", "dataDouble_out"};
+
+    boost::mutex::scoped_lock lock(routingLock);
+    stream.routingVersion = connectionTableVersion;
+    for(int output=0;output<ShiftKernel::OUTPUT_FORMATS;output++)
+    {
+    	map<string, std::set<string> >::const_iterator it = routingTable.find(ports[output]);
+    	stream.routed[output] = (it == routingTable.end()) || it->second.count(stream.streamID);
+    }
+}
+
+//Pushes the shifted output of a packet, or holds it back to be coalesced with the output
+//of the stream's following packets when coalesce_size is set
+void FreqShift_i::deliver(BULKIO::PrecisionUTCTime T, double xdelta, bool EOS, const float *output, size_t size, size_t target)
+{
+    if(target == 0 && state->coalescedSize == 0)
+    {
+    	AllocationCounter::Scope paused(false);
+    	dataFloat_out->pushPacket(output, size, T, EOS, state->streamID);
+    	return;
+    }
+
+    //The time stamp of a coalesced packet only describes its first sample, so held samples
+    //are flushed rather than joined with a packet that does not follow them in time
+    if(state->coalescedSize)
+    {
+    	//Held samples are also flushed when adding this output would overshoot the target
+    	double held = state->coalescedSize/2;
+    	double gap = (T.twsec - state->coalescedT.twsec) + (T.tfsec - state->coalescedT.tfsec) - held*xdelta;
+    	if(std::abs(gap) > xdelta/2 || (state->coalescedSize + size)/2 > target)
+    		flushCoalesced(*state, false);
+    }
+
+    if(state->coalescedSize == 0)
+    {
+    	state->coalescedT = T;
+    	state->coalesceDeadline = boost::posix_time::microsec_clock::universal_time() +
+    			boost::posix_time::microseconds((long)(coalesce_latency*1000.0));
+    	state->holdingSlot = holdingStreams.size();
+    	holdingStreams.push_back(state);
+    	if(nextFlush.is_not_a_date_time() || state->coalesceDeadline < nextFlush)
+    		nextFlush = state->coalesceDeadline;
+    }
+    float *held = state->scratch.get<float>(COALESCE_SCRATCH, state->coalescedSize + size, state->coalescedSize);
+    std::copy(output, output + size, held + state->coalescedSize);
+    state->coalescedSize += size;
+
+    if(EOS || state->coalescedSize/2 >= target ||
+    		boost::posix_time::microsec_clock::universal_time() >= state->coalesceDeadline)
+    	flushCoalesced(*state, EOS);
+}
+
+//Returns the number of output samples to accumulate before pushing, or 0 when the stream
+//is not being coalesced. With adaptive_coalescing the target follows the stream's smoothed
+//input rate so that a packet fills up just as coalesce_latency expires
+size_t FreqShift_i::coalesceTarget(StreamContext &stream, size_t samples)
+{
+    if(coalesce_size == 0)
+    	return 0;
+
+    if(!adaptive_coalescing)
+    	return coalesce_size;
+
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    if(!stream.lastArrival.is_not_a_date_time())
+    {
+    	double elapsed = (now - stream.lastArrival).total_microseconds()/1e6;
+    	if(elapsed > 0)
+    	{
+    		double rate = samples/elapsed;
+    		stream.sampleRate = (stream.sampleRate > 0) ? stream.sampleRate + (rate - stream.sampleRate)/8 : rate;
+    	}
+    }
+    stream.lastArrival = now;
+
+    double target = stream.sampleRate*coalesce_latency/1000.0;
+    return std::max<size_t>(1, std::min<size_t>(coalesce_size, (size_t)target));
+}
+
+//Pushes any output held back for coalescing as a single packet
+void FreqShift_i::flushCoalesced(StreamContext &stream, bool EOS)
+{
+    if(stream.coalescedSize == 0)
+    	return;
+
+    {
+    	AllocationCounter::Scope paused(false);
+    	dataFloat_out->pushPacket(stream.scratch.get<float>(COALESCE_SCRATCH, stream.coalescedSize, stream.coalescedSize),
+    			stream.coalescedSize, stream.coalescedT, EOS, stream.streamID);
+    }
+    stream.coalescedSize = 0;
+
+    StreamContext *last = holdingStreams.back();
+    holdingStreams[stream.holdingSlot] = last;
+    last->holdingSlot = stream.holdingSlot;
+    holdingStreams.pop_back();
+}
+
+//Pushes held output whose coalesce_latency has expired. Returns the time until the next
+//held output expires, in seconds, or a negative value if no output is being held. Until
+//nextFlush is reached this is only a clock read; the streams holding output are only looked
+//at once it has passed, and nextFlush is then worked out again from those still holding
+float FreqShift_i::flushOverdue()
+{
+    if(holdingStreams.empty())
+    	return -1;
+
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    if(now < nextFlush)
+    	return (nextFlush - now).total_microseconds()/1e6;
+
+    nextFlush = boost::posix_time::ptime();
+    size_t i = 0;
+    while(i < holdingStreams.size())
+    {
+    	StreamContext *context = holdingStreams[i];
+    	if(now >= context->coalesceDeadline)
+    	{
+    		//The last holding stream takes this one's place, so i is looked at again
+    		flushCoalesced(*context, false);
+    		continue;
+    	}
+    	if(nextFlush.is_not_a_date_time() || context->coalesceDeadline < nextFlush)
+    		nextFlush = context->coalesceDeadline;
+    	i++;
+    }
+
+    if(nextFlush.is_not_a_date_time())
+    	return -1;
+    return (nextFlush - now).total_microseconds()/1e6;
+}
+
+void FreqShift_i::stop() throw (CF::Resource::StopError, CORBA::SystemException)
+{
+    FreqShift_base::stop();
+
+    //The next processing thread starts out with the process's placement and is placed afresh
+    appliedPlacementVersion = 0;
+    threadBound = false;
+    memoryPolicySet = false;
+    threadScheduled = false;
+
+    //The processing thread has exited, so output still held for coalescing is pushed here
+    while(!holdingStreams.empty())
+    	flushCoalesced(*holdingStreams.back(), false);
 }
 
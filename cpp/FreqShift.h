@@ -20,8 +20,13 @@
 #define COMPLEX tmp->SRI.mode
 
 #include "FreqShift_base.h"
+#include "FreqShifter.h"
+#include "ScratchArena.h"
+#include "StreamTable.h"
+#include "ThreadPlacement.h"
 #include <string>
 #include <map>
+#include <set>
 using std::vector;
 using std::complex;
 using std::cout;
@@ -38,32 +43,189 @@ public:
 	FreqShift_i(const char *uuid, const char *label);
 	~FreqShift_i();
 	int serviceFunction();
+	void stop() throw (CF::Resource::StopError, CORBA::SystemException);
 
+	void stream_prioritiesChanged(const std::vector<stream_priority_struct> *oldValue, const std::vector<stream_priority_struct> *newValue);
+	void default_priorityChanged(const short *oldValue, const short *newValue);
+	void channel_shiftsChanged(const std::vector<float> *oldValue, const std::vector<float> *newValue);
+	void stream_frequenciesChanged(const std::vector<stream_frequency_struct> *oldValue, const std::vector<stream_frequency_struct> *newValue);
+	void frequency_keywordChanged(const std::string *oldValue, const std::string *newValue);
+	void numa_nodeChanged(const CORBA::Long *oldValue, const CORBA::Long *newValue);
+	void cpu_affinityChanged(const std::string *oldValue, const std::string *newValue);
+	void scheduling_policyChanged(const std::string *oldValue, const std::string *newValue);
+	void scheduling_priorityChanged(const short *oldValue, const short *newValue);
+	void lock_memoryChanged(const bool *oldValue, const bool *newValue);
+	void connectionTableChanged(const std::vector<connection_descriptor_struct> *oldValue, const std::vector<connection_descriptor_struct> *newValue);
 
 private:
-	vector<float> shiftedSignal;
-	bool firstTime;	//indicates whether or not current iteration of the service function is the first
-	complex<float> * phasor;
-	map<string, complex<float> > phasor_map;
-
-	//Function passes three vectors (two input vectors (in1 and in2) and one output vector (d))
-	//and computes the product of the corresponding elements of in1 and in2. Template allows
-	//compatibility with multiple data types
-	template<typename T>
-	void vectormultiply(vector<T> &in1, vector<complex<float> > &in2, vector<float> &out)
+	//A packet taken off one of the input ports that is waiting to be serviced, along with
+	//the time it was taken off the port so that its latency can be measured
+	struct PendingPacket
 	{
-		vector<complex<float> > *outputcx = (vector<complex<float> > *)&out;
+		ShiftKernel::InputFormat format;	//port the packet came from
+		void *packet;				//dataTransfer of that port's type
+		boost::posix_time::ptime arrival;
+	};
 
-		if(in1.size() < in2.size())
-			in2.resize(in1.size());
-		else if(in2.size() < in1.size())
-			in1.resize(in2.size());
+	//Packets waiting to be serviced for a single stream. Packets within a stream are
+	//always serviced in arrival order; the scheduler only chooses between streams. The
+	//queue is a ring that grows to the most packets ever waiting for the stream and is
+	//then reused, so queueing a packet does not allocate
+	struct StreamQueue
+	{
+		StreamQueue() : head(0), size(0) {}
+		vector<PendingPacket> ring;
+		size_t head;
+		size_t size;
+
+		bool empty() const { return size == 0; }
+		PendingPacket &front() { return ring[head]; }
+		void pop_front() { head = (head + 1) % ring.size(); size--; }
+		void push_back(const PendingPacket &entry);
+	};
+
+	//Running latency totals for one priority class
+	struct LatencyStats
+	{
+		LatencyStats() : packets(0), total(0), max(0) {}
+		unsigned long packets;
+		double total;
+		double max;
+	};
+
+	//Uses of each stream's scratch arena
+	enum ScratchSlot
+	{
+		OUTPUT_SCRATCH,		//shifted output that cannot be written over the input
+		COALESCE_SCRATCH,	//shifted output held back for coalescing
+		CONVERTED_SCRATCH	//output for whichever port other than dataFloat_out is being pushed
+	};
+
+	//Everything kept for one stream: its waiting packets, its output SRI state, its kernel, the
+	//phase and rotation carried between its packets, its scratch buffers and any output held
+	//back for coalescing
+	struct StreamContext : public StreamTableEntry
+	{
+		StreamContext() : priority(0), waitingSlot(0), sriPushed(false), format(ShiftKernel::FLOAT_INPUT), phasor(1,0), deltaTheta(1,0), frequencyOverridden(false), overrideFrequency(0), frequencyOverridesVersion(0), frequency(0), xdelta(0), channels(1), channelShiftsVersion(0), routingVersion(0), coalescedSize(0), holdingSlot(0), sampleRate(0)
+		{
+			std::fill(kernel, kernel + ShiftKernel::OUTPUT_FORMATS, (const ShiftKernel *)NULL);
+			std::fill(routed, routed + ShiftKernel::OUTPUT_FORMATS, true);
+		}
+
+		short priority;
+		StreamQueue queue;
+		size_t waitingSlot;		//position in waitingStreams while queue is not empty
+		bool sriPushed;			//the stream's SRI has been pushed since it started
+
+		ShiftKernel::InputFormat format;	//port the stream is arriving on
+		//Kernels for each output port, chosen for the current SRI and frequency_shift
+		const ShiftKernel *kernel[ShiftKernel::OUTPUT_FORMATS];
+		complex<double> phasor;
+		complex<double> deltaTheta;	//rotation applied per sample
+
+		//The stream's shift, when it comes from stream_frequencies or its SRI rather than
+		//frequency_shift. Worked out again only when its SRI or the overrides change
+		bool frequencyOverridden;
+		float overrideFrequency;
+		unsigned int frequencyOverridesVersion;	//frequencyOverridesVersion the shift was worked out for
+		float frequency;		//shift deltaTheta was computed for
+		double xdelta;			//sample period deltaTheta was computed for
+
+		//Framed input: the phase and rotation of each channel, worked out from channel_shifts
+		size_t channels;		//channels per frame, 1 when the input is not framed
+		vector<complex<double> > channelPhasors;
+		vector<complex<double> > channelDeltas;
+		unsigned int channelShiftsVersion;	//channelShiftsVersion channelDeltas were worked out for
+
+		//Output ports the connection filter lets the stream through to
+		bool routed[ShiftKernel::OUTPUT_FORMATS];
+		unsigned int routingVersion;	//connectionTableVersion routed was worked out for
+
+		ScratchArena scratch;				//see ScratchSlot
+		size_t coalescedSize;				//floats held back for coalescing
+		BULKIO::PrecisionUTCTime coalescedT;		//time stamp of the first held sample
+		boost::posix_time::ptime coalesceDeadline;	//when the held output must be pushed
+		size_t holdingSlot;				//position in holdingStreams while output is held
+		boost::posix_time::ptime lastArrival;
+		double sampleRate;				//smoothed input rate, in samples per second
+	};
 
-		outputcx->resize(in1.size());
+	void fillSchedule();
+	template<typename Port>
+	bool takePacket(Port *port, ShiftKernel::InputFormat format, float timeout);
+	bool pollInputs();
+	bool spinForPacket(float limit);
+	void idleWait(float untilFlush);
+	size_t queuedPackets();
+	void publishWakeups();
+	bool servicePacket(const PendingPacket &entry);
+	static void releasePacket(const PendingPacket &entry);
+	StreamContext *nextScheduled();
+	PendingPacket dequeue(StreamContext &stream);
+	size_t serviceLanes();
+	bool laneEligible(const StreamContext &stream);
+	StreamContext *contextFor(const string &streamID);
+	void reclaim(StreamContext *context);
+	short priorityOf(const string &streamID);
+	void recordLatency(short priority, const PendingPacket &serviced);
+	void publishStatus();
+	void applyPlacement();
+	template<typename Packet>
+	void processPacket(Packet *tmp, ShiftKernel::InputFormat format);
+	template<typename Element, typename Port>
+	void pushConverted(Port *port, const ShiftKernel &kernel, const char *in, size_t count,
+			const BULKIO::PrecisionUTCTime &T, bool EOS);
+	void shiftSamples(const ShiftKernel &kernel, const char *in, size_t count, float outputScale, void *output);
+	void advancePhase(StreamContext &stream, size_t count);
+	void resolveChannelShifts(StreamContext &stream);
+	void resolveFrequency(StreamContext &stream, const BULKIO::StreamSRI &sri);
+	void resolveRouting(StreamContext &stream);
+	void deliver(BULKIO::PrecisionUTCTime T, double xdelta, bool EOS, const float *output, size_t size, size_t target);
+	size_t coalesceTarget(StreamContext &stream, size_t samples);
+	void flushCoalesced(StreamContext &stream, bool EOS);
+	float flushOverdue();
 
-		transform(in1.begin(), in1.end(), in2.begin(), outputcx->begin(), std::multiplies<complex<float> >());
-	}
+	StreamTable<StreamContext> streams;
+	StreamContext *state;		//context of the stream being serviced
+	vector<StreamContext *> holdingStreams;	//streams holding output for coalescing, in no particular order
+	boost::posix_time::ptime nextFlush;	//no later than the earliest coalesceDeadline of holdingStreams
+	ScratchArena laneScratch;	//structure-of-arrays block for packets shifted across streams
 
+	size_t pendingCount;
+	vector<StreamContext *> waitingStreams;	//streams with packets waiting, in no particular order
+	size_t wakeups;				//returns from waiting or sleeping since wakeupWindow began
+	boost::posix_time::ptime wakeupWindow;	//start of the period wakeups_per_second is measured over
+	double packetRate;			//smoothed rate of packets queuing on the input ports while idle
+	ShiftKernel::InputFormat lastInput;	//port the most recent packet arrived on
+	map<string, short> priorityTable;	//stream_priorities keyed by stream ID
+	short defaultPriority;
+	boost::mutex priorityLock;		//guards priorityTable and defaultPriority
+	map<short, LatencyStats> latencyStats;
+	vector<float> channelShifts;		//copy of channel_shifts
+	unsigned int channelShiftsVersion;	//bumped whenever channel_shifts changes
+	boost::mutex channelLock;		//guards channelShifts and channelShiftsVersion
+	map<string, float> frequencyTable;	//stream_frequencies entries naming a single stream
+	vector<std::pair<string, float> > frequencyPatterns;	//stream_frequencies entries with wildcards, in order
+	string frequencyKeyword;		//copy of frequency_keyword
+	unsigned int frequencyOverridesVersion;	//bumped whenever stream_frequencies or frequency_keyword changes
+	boost::mutex frequencyLock;		//guards the frequency overrides and their version
+	map<string, std::set<string> > routingTable;	//connectionTable stream IDs keyed by output port
+	unsigned int connectionTableVersion;	//bumped whenever connectionTable changes
+	boost::mutex routingLock;		//guards routingTable and connectionTableVersion
+	int numaNode;				//copy of numa_node
+	string cpuAffinity;			//copy of cpu_affinity
+	string schedulingPolicy;		//copy of scheduling_policy
+	short schedulingPriority;		//copy of scheduling_priority
+	bool lockMemory;			//copy of lock_memory
+	bool memoryLocked;			//lock_memory has been applied
+	int placedNode;				//node the scratch buffers were grown under
+	string placedCpus;			//CPUs the scratch buffers were grown under
+	unsigned int placementVersion;		//bumped whenever any of the copies above changes
+	unsigned int appliedPlacementVersion;	//placementVersion the processing thread was placed for
+	bool threadBound;			//the processing thread has been bound to a set of CPUs
+	bool memoryPolicySet;			//the processing thread's memory policy has been set for numa_node
+	bool threadScheduled;			//the processing thread's scheduling has been set for scheduling_policy
+	boost::mutex placementLock;		//guards the placement copies and placementVersion
 };
 
 #endif // FREQSHIFT_IMPL_H
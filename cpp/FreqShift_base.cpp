@@ -34,16 +34,40 @@ FreqShift_base::FreqShift_base(const char *uuid, const char *label) :
 
     dataFloat_in = new bulkio::InFloatPort("dataFloat_in");
     addPort("dataFloat_in", dataFloat_in);
+    dataShort_in = new bulkio::InShortPort("dataShort_in");
+    addPort("dataShort_in", dataShort_in);
+    dataOctet_in = new bulkio::InOctetPort("dataOctet_in");
+    addPort("dataOctet_in", dataOctet_in);
+    dataDouble_in = new bulkio::InDoublePort("dataDouble_in");
+    addPort("dataDouble_in", dataDouble_in);
     dataFloat_out = new bulkio::OutFloatPort("dataFloat_out");
     addPort("dataFloat_out", dataFloat_out);
+    dataShort_out = new bulkio::OutShortPort("dataShort_out");
+    addPort("dataShort_out", dataShort_out);
+    dataOctet_out = new bulkio::OutOctetPort("dataOctet_out");
+    addPort("dataOctet_out", dataOctet_out);
+    dataDouble_out = new bulkio::OutDoublePort("dataDouble_out");
+    addPort("dataDouble_out", dataDouble_out);
 }
 
 FreqShift_base::~FreqShift_base()
 {
     delete dataFloat_in;
     dataFloat_in = 0;
+    delete dataShort_in;
+    dataShort_in = 0;
+    delete dataOctet_in;
+    dataOctet_in = 0;
+    delete dataDouble_in;
+    dataDouble_in = 0;
     delete dataFloat_out;
     dataFloat_out = 0;
+    delete dataShort_out;
+    dataShort_out = 0;
+    delete dataOctet_out;
+    dataOctet_out = 0;
+    delete dataDouble_out;
+    dataDouble_out = 0;
 }
 
 /*******************************************************************************************
@@ -87,4 +111,332 @@ void FreqShift_base::loadProperties()
                 "external",
                 "configure");
 
+    addProperty(max_output_packet_size,
+                0,
+                "max_output_packet_size",
+                "",
+                "readwrite",
+                "samples",
+                "external",
+                "configure");
+
+    addProperty(coalesce_size,
+                0,
+                "coalesce_size",
+                "",
+                "readwrite",
+                "samples",
+                "external",
+                "configure");
+
+    addProperty(coalesce_latency,
+                10,
+                "coalesce_latency",
+                "",
+                "readwrite",
+                "ms",
+                "external",
+                "configure");
+
+    addProperty(adaptive_coalescing,
+                false,
+                "adaptive_coalescing",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(shrink_scratch,
+                false,
+                "shrink_scratch",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(scratch_bytes,
+                0,
+                "scratch_bytes",
+                "",
+                "readonly",
+                "bytes",
+                "external",
+                "configure");
+
+    addProperty(huge_page_scratch,
+                false,
+                "huge_page_scratch",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(huge_pages,
+                0,
+                "huge_pages",
+                "",
+                "readonly",
+                "pages",
+                "external",
+                "configure");
+
+    addProperty(hot_path_allocations,
+                -1,
+                "hot_path_allocations",
+                "",
+                "readonly",
+                "",
+                "external",
+                "configure");
+
+    addProperty(max_streams,
+                1024,
+                "max_streams",
+                "",
+                "readwrite",
+                "streams",
+                "external",
+                "configure");
+
+    addProperty(active_streams,
+                0,
+                "active_streams",
+                "",
+                "readonly",
+                "streams",
+                "external",
+                "configure");
+
+    addProperty(default_priority,
+                0,
+                "default_priority",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(stream_priorities,
+                "stream_priorities",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(scheduler_depth,
+                16,
+                "scheduler_depth",
+                "",
+                "readwrite",
+                "packets",
+                "external",
+                "configure");
+
+    addProperty(batch_size,
+                1,
+                "batch_size",
+                "",
+                "readwrite",
+                "packets",
+                "external",
+                "configure");
+
+    addProperty(starvation_limit,
+                500,
+                "starvation_limit",
+                "",
+                "readwrite",
+                "ms",
+                "external",
+                "configure");
+
+    addProperty(spin_budget,
+                0,
+                "spin_budget",
+                "",
+                "readwrite",
+                "us",
+                "external",
+                "configure");
+
+    addProperty(spin_pause_limit,
+                64,
+                "spin_pause_limit",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(idle_wakeup_packets,
+                0,
+                "idle_wakeup_packets",
+                "",
+                "readwrite",
+                "packets",
+                "external",
+                "configure");
+
+    addProperty(idle_wakeup_delay,
+                100,
+                "idle_wakeup_delay",
+                "",
+                "readwrite",
+                "ms",
+                "external",
+                "configure");
+
+    addProperty(wakeups_per_second,
+                0,
+                "wakeups_per_second",
+                "",
+                "readonly",
+                "Hz",
+                "external",
+                "configure");
+
+    addProperty(priority_latency,
+                "priority_latency",
+                "",
+                "readonly",
+                "",
+                "external",
+                "configure");
+
+    addProperty(input_scale,
+                1.0,
+                "input_scale",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(output_scale,
+                1.0,
+                "output_scale",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(channel_shifts,
+                "channel_shifts",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(stream_frequencies,
+                "stream_frequencies",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(frequency_keyword,
+                "",
+                "frequency_keyword",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(connectionTable,
+                "connectionTable",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(cross_stream_lanes,
+                0,
+                "cross_stream_lanes",
+                "",
+                "readwrite",
+                "streams",
+                "external",
+                "configure");
+
+    addProperty(cross_stream_packet_limit,
+                128,
+                "cross_stream_packet_limit",
+                "",
+                "readwrite",
+                "samples",
+                "external",
+                "configure");
+
+    addProperty(streaming_threshold,
+                2097152,
+                "streaming_threshold",
+                "",
+                "readwrite",
+                "samples",
+                "external",
+                "configure");
+
+    addProperty(numa_node,
+                -1,
+                "numa_node",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(cpu_affinity,
+                "",
+                "cpu_affinity",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(scheduling_policy,
+                "SCHED_OTHER",
+                "scheduling_policy",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(scheduling_priority,
+                1,
+                "scheduling_priority",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(lock_memory,
+                false,
+                "lock_memory",
+                "",
+                "readwrite",
+                "",
+                "external",
+                "configure");
+
+    addProperty(placement,
+                "",
+                "placement",
+                "",
+                "readonly",
+                "",
+                "external",
+                "configure");
+
 }
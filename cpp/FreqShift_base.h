@@ -22,6 +22,7 @@
 #include <ossie/ThreadedComponent.h>
 
 #include <bulkio/bulkio.h>
+#include "struct_props.h"
 
 class FreqShift_base : public Resource_impl, protected ThreadedComponent
 {
@@ -40,10 +41,53 @@ class FreqShift_base : public Resource_impl, protected ThreadedComponent
     protected:
         // Member variables exposed as properties
         float frequency_shift;
+        CORBA::ULong max_output_packet_size;
+        CORBA::ULong coalesce_size;
+        float coalesce_latency;
+        bool adaptive_coalescing;
+        bool shrink_scratch;
+        CORBA::ULongLong scratch_bytes;
+        bool huge_page_scratch;
+        CORBA::ULong huge_pages;
+        CORBA::Long hot_path_allocations;
+        CORBA::ULong max_streams;
+        CORBA::ULong active_streams;
+        short default_priority;
+        CORBA::ULong scheduler_depth;
+        CORBA::ULong batch_size;
+        float starvation_limit;
+        CORBA::ULong spin_budget;
+        CORBA::ULong spin_pause_limit;
+        CORBA::ULong idle_wakeup_packets;
+        float idle_wakeup_delay;
+        float wakeups_per_second;
+        std::vector<stream_priority_struct> stream_priorities;
+        std::vector<priority_latency_entry_struct> priority_latency;
+        float input_scale;
+        float output_scale;
+        std::vector<float> channel_shifts;
+        std::vector<stream_frequency_struct> stream_frequencies;
+        std::string frequency_keyword;
+        std::vector<connection_descriptor_struct> connectionTable;
+        CORBA::ULong cross_stream_lanes;
+        CORBA::ULong cross_stream_packet_limit;
+        CORBA::ULong streaming_threshold;
+        CORBA::Long numa_node;
+        std::string cpu_affinity;
+        std::string scheduling_policy;
+        short scheduling_priority;
+        bool lock_memory;
+        std::string placement;
 
         // Ports
         bulkio::InFloatPort *dataFloat_in;
+        bulkio::InShortPort *dataShort_in;
+        bulkio::InOctetPort *dataOctet_in;
+        bulkio::InDoublePort *dataDouble_in;
         bulkio::OutFloatPort *dataFloat_out;
+        bulkio::OutShortPort *dataShort_out;
+        bulkio::OutOctetPort *dataOctet_out;
+        bulkio::OutDoublePort *dataDouble_out;
 
     private:
 };
@@ -0,0 +1,185 @@
+/*
+* Copyright (C) 2015 Axios, Inc.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FreqShifter.h"
+#include <cmath>
+
+namespace
+{
+	enum SpecialCaseIndex
+	{
+		GENERAL_SHIFT,
+		ZERO_SHIFT,
+		QUARTER_RATE_SHIFT,
+		HALF_RATE_SHIFT,
+		THREE_QUARTER_RATE_SHIFT,
+		SPECIAL_CASES
+	};
+
+	//The kernels for one input and output sample layout, indexed by SpecialCaseIndex
+	template<typename InputSample, typename OutputSample>
+	struct KernelRow
+	{
+		static const ShiftKernel *const kernels[SPECIAL_CASES];
+	};
+
+	template<typename InputSample, typename OutputSample>
+	const ShiftKernel *const KernelRow<InputSample, OutputSample>::kernels[SPECIAL_CASES] = {
+		&FreqShifter<InputSample, OutputSample, RecurrenceNco, GeneralShift<RecurrenceNco> >::kernel,
+		&FreqShifter<InputSample, OutputSample, RecurrenceNco, ZeroShift>::kernel,
+		&FreqShifter<InputSample, OutputSample, RecurrenceNco, QuarterRateShift>::kernel,
+		&FreqShifter<InputSample, OutputSample, RecurrenceNco, HalfRateShift>::kernel,
+		&FreqShifter<InputSample, OutputSample, RecurrenceNco, ThreeQuarterRateShift>::kernel
+	};
+
+	//The rows for one input element type, indexed by [OutputFormat][complexInput]
+	template<typename Element>
+	struct KernelTable
+	{
+		static const ShiftKernel *const *const rows[ShiftKernel::OUTPUT_FORMATS][2];
+	};
+
+	template<typename Element>
+	const ShiftKernel *const *const KernelTable<Element>::rows[ShiftKernel::OUTPUT_FORMATS][2] = {
+		{ KernelRow<RealSample<Element>, ComplexOutput<float> >::kernels,
+		  KernelRow<ComplexSample<Element>, ComplexOutput<float> >::kernels },
+		{ KernelRow<RealSample<Element>, QuantizedOutput<short> >::kernels,
+		  KernelRow<ComplexSample<Element>, QuantizedOutput<short> >::kernels },
+		{ KernelRow<RealSample<Element>, QuantizedOutput<unsigned char> >::kernels,
+		  KernelRow<ComplexSample<Element>, QuantizedOutput<unsigned char> >::kernels },
+		{ KernelRow<RealSample<Element>, ComplexOutput<double> >::kernels,
+		  KernelRow<ComplexSample<Element>, ComplexOutput<double> >::kernels }
+	};
+
+	//Tables indexed by InputFormat
+	typedef const ShiftKernel *const *const KernelRows[ShiftKernel::OUTPUT_FORMATS][2];
+	KernelRows *const kernels[ShiftKernel::INPUT_FORMATS] = {
+		&KernelTable<float>::rows,
+		&KernelTable<short>::rows,
+		&KernelTable<unsigned char>::rows,
+		&KernelTable<double>::rows
+	};
+
+	//A shift is treated as a special case only when it is a whole number of quarter cycles
+	//per sample to well within float precision, so the exact kernel matches what the general
+	//one would have produced
+	const double SPECIAL_CASE_TOLERANCE = 1e-9;
+}
+
+const ShiftKernel *ShiftKernel::select(InputFormat format, bool complexInput, OutputFormat output, double cyclesPerSample)
+{
+	double cycles = cyclesPerSample - std::floor(cyclesPerSample);
+	double quarters = std::floor(4*cycles + 0.5);
+
+	SpecialCaseIndex index = GENERAL_SHIFT;
+	if(std::fabs(4*cycles - quarters) < 4*SPECIAL_CASE_TOLERANCE)
+		index = SpecialCaseIndex(ZERO_SHIFT + (int(quarters) % 4));
+
+	return (*kernels[format])[output][complexInput ? 1 : 0][index];
+}
+
+void LaneShifter::process(const Lane *lanes, size_t laneCount, float *scratch)
+{
+	size_t longest = 0;
+	for(size_t l=0;l<laneCount;l++)
+		longest = std::max(longest, lanes[l].count);
+
+	//Gather. Lanes past the end of their packet, and unused lanes, are zero
+	float *re = scratch;
+	float *im = scratch + LANES*longest;
+	std::fill(scratch, scratch + scratchSize(longest), 0.0f);
+	for(size_t l=0;l<laneCount;l++)
+	{
+		const Lane &lane = lanes[l];
+		if(lane.complexInput)
+		{
+			for(size_t i=0;i<lane.count;i++)
+			{
+				re[i*LANES + l] = lane.input[2*i];
+				im[i*LANES + l] = lane.input[2*i+1];
+			}
+		}
+		else
+		{
+			for(size_t i=0;i<lane.count;i++)
+				re[i*LANES + l] = lane.input[i];
+		}
+	}
+
+	float pr[LANES], pi[LANES], dr[LANES], di[LANES];
+	for(size_t l=0;l<LANES;l++)
+	{
+		bool used = l < laneCount;
+		pr[l] = used ? lanes[l].phasor.real() : 1;
+		pi[l] = used ? lanes[l].phasor.imag() : 0;
+		dr[l] = used ? lanes[l].deltaTheta.real() : 1;
+		di[l] = used ? lanes[l].deltaTheta.imag() : 0;
+	}
+
+	//Rotate, one sample of every lane per step. With SSE2 the lanes go four to a register;
+	//every row of the block starts on a 16-byte boundary, since the scratch does and LANES is
+	//a multiple of four
+#ifdef __SSE2__
+	__m128 phaseReal[GROUPS], phaseImag[GROUPS], stepReal[GROUPS], stepImag[GROUPS];
+	for(size_t g=0;g<GROUPS;g++)
+	{
+		phaseReal[g] = _mm_loadu_ps(pr + 4*g);
+		phaseImag[g] = _mm_loadu_ps(pi + 4*g);
+		stepReal[g] = _mm_loadu_ps(dr + 4*g);
+		stepImag[g] = _mm_loadu_ps(di + 4*g);
+	}
+	for(size_t i=0;i<longest;i++)
+	{
+		float *r = re + i*LANES;
+		float *m = im + i*LANES;
+		for(size_t g=0;g<GROUPS;g++)
+		{
+			__m128 xr = _mm_load_ps(r + 4*g);
+			__m128 xi = _mm_load_ps(m + 4*g);
+			_mm_store_ps(r + 4*g, _mm_sub_ps(_mm_mul_ps(xr, phaseReal[g]), _mm_mul_ps(xi, phaseImag[g])));
+			_mm_store_ps(m + 4*g, _mm_add_ps(_mm_mul_ps(xr, phaseImag[g]), _mm_mul_ps(xi, phaseReal[g])));
+			__m128 next = _mm_sub_ps(_mm_mul_ps(phaseReal[g], stepReal[g]), _mm_mul_ps(phaseImag[g], stepImag[g]));
+			phaseImag[g] = _mm_add_ps(_mm_mul_ps(phaseReal[g], stepImag[g]), _mm_mul_ps(phaseImag[g], stepReal[g]));
+			phaseReal[g] = next;
+		}
+	}
+#else
+	for(size_t i=0;i<longest;i++)
+	{
+		float *r = re + i*LANES;
+		float *m = im + i*LANES;
+		for(size_t l=0;l<LANES;l++)
+		{
+			float xr = r[l];
+			float xi = m[l];
+			r[l] = xr*pr[l] - xi*pi[l];
+			m[l] = xr*pi[l] + xi*pr[l];
+			float next = pr[l]*dr[l] - pi[l]*di[l];
+			pi[l] = pr[l]*di[l] + pi[l]*dr[l];
+			pr[l] = next;
+		}
+	}
+#endif
+
+	//Scatter
+	for(size_t l=0;l<laneCount;l++)
+	{
+		const Lane &lane = lanes[l];
+		for(size_t i=0;i<lane.count;i++)
+			lane.output[i] = std::complex<float>(re[i*LANES + l], im[i*LANES + l]);
+	}
+}
@@ -0,0 +1,820 @@
+/*
+* Copyright (C) 2015 Axios, Inc.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FREQSHIFTER_H
+#define FREQSHIFTER_H
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+//A shift kernel, chosen once for a stream whenever its SRI or the shift frequency changes
+//so that the per-packet path never has to look at the input mode or the shift again.
+struct ShiftKernel
+{
+	//Sample types received on each input port
+	enum InputFormat
+	{
+		FLOAT_INPUT,
+		SHORT_INPUT,
+		OCTET_INPUT,
+		DOUBLE_INPUT,
+		INPUT_FORMATS
+	};
+
+	//Sample types sent on each output port
+	enum OutputFormat
+	{
+		FLOAT_OUTPUT,
+		SHORT_OUTPUT,
+		OCTET_OUTPUT,
+		DOUBLE_OUTPUT,
+		OUTPUT_FORMATS
+	};
+
+	size_t inputSize;	//bytes per input sample
+	size_t outputSize;	//bytes per output sample
+
+	//Converts count samples from input to float, multiplies them by inputScale (integer input
+	//only) and rotates them by a complex exponential that starts at phasor and advances by
+	//deltaTheta per sample, leaving phasor at the start of the next block. The results are
+	//multiplied by outputScale and quantized when the output is integer. output may be the
+	//same as input only when the output samples are no wider than the input samples. The
+	//phase is kept in double precision between blocks; kernels with neither double input nor
+	//double output run the exponential in float
+	void (*process)(const void *input, size_t count, float inputScale, float outputScale,
+			std::complex<double> &phasor, const std::complex<double> &deltaTheta, void *output);
+
+	//The same as process, for packets much larger than the last level cache. The input is
+	//prefetched ahead of use and the output is written with non-temporal stores, so that
+	//writing it neither reads each output line in first nor evicts input still to be shifted
+	void (*processStreaming)(const void *input, size_t count, float inputScale, float outputScale,
+			std::complex<double> &phasor, const std::complex<double> &deltaTheta, void *output);
+
+	//Shifts count samples of framed input, in which each frame holds one sample from each of
+	//channels channels. Channel c starts at phasors[c] and advances by deltaThetas[c] per frame;
+	//the phasors are not updated, so the caller advances them once for all of its outputs. The
+	//count need not be a whole number of frames. output may be the same as input only when the
+	//output samples are the same size as the input samples
+	void (*processFramed)(const void *input, size_t count, size_t channels, float inputScale, float outputScale,
+			const std::complex<double> *phasors, const std::complex<double> *deltaThetas, void *output);
+
+	//Picks the kernel for an input format and mode, an output format and a shift of
+	//cyclesPerSample (the shift frequency times the sample period)
+	static const ShiftKernel *select(InputFormat format, bool complexInput, OutputFormat output, double cyclesPerSample);
+};
+
+//Conversion of received samples to float. Integer samples are multiplied by the scale as
+//they are converted; octets are offset binary, with 128 as zero. Doubles are left in
+//double precision
+template<typename Element>
+struct SampleConversion
+{
+	static float apply(Element x, float scale) { return x*scale; }
+};
+
+template<>
+struct SampleConversion<float>
+{
+	static float apply(float x, float) { return x; }
+};
+
+template<>
+struct SampleConversion<double>
+{
+	static double apply(double x, float) { return x; }
+};
+
+template<>
+struct SampleConversion<unsigned char>
+{
+	static float apply(unsigned char x, float scale) { return (int(x) - 128)*scale; }
+};
+
+#ifdef __SSE2__
+//Loads and stores of a whole register, aligned or not
+template<bool Aligned>
+struct SseAccess
+{
+	static __m128 load(const float *p) { return _mm_loadu_ps(p); }
+	static void store(float *p, __m128 x) { _mm_storeu_ps(p, x); }
+	static void store(__m128i *p, __m128i x) { _mm_storeu_si128(p, x); }
+};
+
+template<>
+struct SseAccess<true>
+{
+	static __m128 load(const float *p) { return _mm_load_ps(p); }
+	static void store(float *p, __m128 x) { _mm_store_ps(p, x); }
+	static void store(__m128i *p, __m128i x) { _mm_store_si128(p, x); }
+};
+
+//The same conversion four samples at a time, for the kernels that run in float. Aligned
+//says whether in is on a 16-byte boundary; only float input is loaded a register at a time
+template<typename Element>
+struct SseConversion;
+
+template<>
+struct SseConversion<float>
+{
+	template<bool Aligned>
+	static __m128 apply(const float *in, __m128) { return SseAccess<Aligned>::load(in); }
+};
+
+template<>
+struct SseConversion<short>
+{
+	template<bool Aligned>
+	static __m128 apply(const short *in, __m128 scale)
+	{
+		__m128i x = _mm_loadl_epi64((const __m128i *)in);
+		x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		return _mm_mul_ps(_mm_cvtepi32_ps(x), scale);
+	}
+};
+
+template<>
+struct SseConversion<unsigned char>
+{
+	template<bool Aligned>
+	static __m128 apply(const unsigned char *in, __m128 scale)
+	{
+		int bytes;
+		std::memcpy(&bytes, in, sizeof(bytes));
+		const __m128i zero = _mm_setzero_si128();
+		__m128i x = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+		x = _mm_sub_epi32(x, _mm_set1_epi32(128));
+		return _mm_mul_ps(_mm_cvtepi32_ps(x), scale);
+	}
+};
+#endif
+
+//Input sample layouts: one element per real sample, or an interleaved pair per complex
+//sample. shift returns sample i of in converted and rotated by current
+template<typename Element>
+struct RealSample
+{
+	typedef Element element_type;
+	static const size_t size = sizeof(Element);
+
+	template<typename Real>
+	static std::complex<Real> shift(const Element *in, size_t i, float scale, const std::complex<Real> &current)
+	{
+		return current*Real(SampleConversion<Element>::apply(in[i], scale));
+	}
+
+#ifdef __SSE2__
+	//Samples i to i+3 rotated by four phasors, given and returned as real and imaginary parts.
+	//Aligned says whether sample i starts on a 16-byte boundary
+	template<bool Aligned>
+	static void shift4(const Element *in, size_t i, __m128 scale, __m128 currentReal, __m128 currentImag,
+			__m128 &real, __m128 &imag)
+	{
+		__m128 x = SseConversion<Element>::template apply<Aligned>(in + i, scale);
+		real = _mm_mul_ps(x, currentReal);
+		imag = _mm_mul_ps(x, currentImag);
+	}
+#endif
+};
+
+template<typename Element>
+struct ComplexSample
+{
+	typedef Element element_type;
+	static const size_t size = 2*sizeof(Element);
+
+	template<typename Real>
+	static std::complex<Real> shift(const Element *in, size_t i, float scale, const std::complex<Real> &current)
+	{
+		std::complex<Real> x(SampleConversion<Element>::apply(in[2*i], scale), SampleConversion<Element>::apply(in[2*i+1], scale));
+		return x*current;
+	}
+
+#ifdef __SSE2__
+	template<bool Aligned>
+	static void shift4(const Element *in, size_t i, __m128 scale, __m128 currentReal, __m128 currentImag,
+			__m128 &real, __m128 &imag)
+	{
+		__m128 low = SseConversion<Element>::template apply<Aligned>(in + 2*i, scale);	//r0 i0 r1 i1
+		__m128 high = SseConversion<Element>::template apply<Aligned>(in + 2*i + 4, scale);	//r2 i2 r3 i3
+		__m128 xr = _mm_shuffle_ps(low, high, _MM_SHUFFLE(2,0,2,0));
+		__m128 xi = _mm_shuffle_ps(low, high, _MM_SHUFFLE(3,1,3,1));
+		real = _mm_sub_ps(_mm_mul_ps(xr, currentReal), _mm_mul_ps(xi, currentImag));
+		imag = _mm_add_ps(_mm_mul_ps(xr, currentImag), _mm_mul_ps(xi, currentReal));
+	}
+#endif
+};
+
+//Rounds to the nearest integer, saturating at low and high
+inline int saturate(float x, int low, int high)
+{
+	x = std::min(std::max(x, float(low)), float(high));
+	return int(x < 0 ? x - 0.5f : x + 0.5f);
+}
+
+//Conversion of shifted samples to integer output, multiplied by the scale and saturated at
+//the limits of the output type. Octets are offset binary, as on input
+template<typename Element>
+struct SampleQuantization;
+
+template<>
+struct SampleQuantization<short>
+{
+	static short apply(float x, float scale) { return short(saturate(x*scale, -32768, 32767)); }
+};
+
+template<>
+struct SampleQuantization<unsigned char>
+{
+	static unsigned char apply(float x, float scale) { return (unsigned char)(saturate(x*scale, -128, 127) + 128); }
+};
+
+#ifdef __SSE2__
+//saturate for four samples, rounding halves away from zero in the same way
+inline __m128i ssesaturate(__m128 x, int low, int high)
+{
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(float(low))), _mm_set1_ps(float(high)));
+	__m128 half = _mm_or_ps(_mm_set1_ps(0.5f), _mm_and_ps(x, _mm_set1_ps(-0.0f)));
+	return _mm_cvttps_epi32(_mm_add_ps(x, half));
+}
+
+//The same quantization four complex samples at a time, from their real and imaginary parts.
+//Aligned says whether out is on a 16-byte boundary; four octet samples fill only half a
+//register and are written the same way either way
+template<typename Element>
+struct SseQuantization;
+
+template<>
+struct SseQuantization<short>
+{
+	template<bool Aligned>
+	static void apply(short *out, __m128 real, __m128 imag, __m128 scale)
+	{
+		__m128i r = ssesaturate(_mm_mul_ps(real, scale), -32768, 32767);
+		__m128i i = ssesaturate(_mm_mul_ps(imag, scale), -32768, 32767);
+		SseAccess<Aligned>::store((__m128i *)out, _mm_packs_epi32(_mm_unpacklo_epi32(r, i), _mm_unpackhi_epi32(r, i)));
+	}
+};
+
+template<>
+struct SseQuantization<unsigned char>
+{
+	template<bool Aligned>
+	static void apply(unsigned char *out, __m128 real, __m128 imag, __m128 scale)
+	{
+		const __m128i offset = _mm_set1_epi32(128);
+		__m128i r = _mm_add_epi32(ssesaturate(_mm_mul_ps(real, scale), -128, 127), offset);
+		__m128i i = _mm_add_epi32(ssesaturate(_mm_mul_ps(imag, scale), -128, 127), offset);
+		__m128i words = _mm_packs_epi32(_mm_unpacklo_epi32(r, i), _mm_unpackhi_epi32(r, i));
+		_mm_storel_epi64((__m128i *)out, _mm_packus_epi16(words, words));
+	}
+};
+#endif
+
+//Output sample layouts. Output is always complex; store writes shifted sample i to out
+template<typename T>
+struct ComplexOutput
+{
+	typedef std::complex<T> element_type;
+	static const size_t size = sizeof(std::complex<T>);
+
+	template<typename Real>
+	static void store(std::complex<T> *out, size_t i, const std::complex<Real> &x, float)
+	{
+		out[i] = std::complex<T>(x.real(), x.imag());
+	}
+
+#ifdef __SSE2__
+	//Writes samples i to i+3, given as their real and imaginary parts. Aligned says whether
+	//sample i starts on a 16-byte boundary. Only float output is shifted four samples at a time
+	template<bool Aligned>
+	static void store4(std::complex<T> *out, size_t i, __m128 real, __m128 imag, __m128)
+	{
+		SseAccess<Aligned>::store((float *)(out + i), _mm_unpacklo_ps(real, imag));
+		SseAccess<Aligned>::store((float *)(out + i + 2), _mm_unpackhi_ps(real, imag));
+	}
+#endif
+};
+
+template<typename Element>
+struct QuantizedOutput
+{
+	typedef Element element_type;
+	static const size_t size = 2*sizeof(Element);
+
+	template<typename Real>
+	static void store(Element *out, size_t i, const std::complex<Real> &x, float scale)
+	{
+		out[2*i] = SampleQuantization<Element>::apply(x.real(), scale);
+		out[2*i+1] = SampleQuantization<Element>::apply(x.imag(), scale);
+	}
+
+#ifdef __SSE2__
+	template<bool Aligned>
+	static void store4(Element *out, size_t i, __m128 real, __m128 imag, __m128 scale)
+	{
+		SseQuantization<Element>::template apply<Aligned>(out + 2*i, real, imag, scale);
+	}
+#endif
+};
+
+//Precision the exponential is run in: double when either end of the kernel is double
+template<typename InputElement, typename OutputElement>
+struct KernelPrecision
+{
+	typedef float type;
+};
+
+template<typename OutputElement>
+struct KernelPrecision<double, OutputElement>
+{
+	typedef double type;
+};
+
+template<typename InputElement>
+struct KernelPrecision<InputElement, std::complex<double> >
+{
+	typedef double type;
+};
+
+template<>
+struct KernelPrecision<double, std::complex<double> >
+{
+	typedef double type;
+};
+
+//Raises a unit phasor to an integer power by repeated squaring, which keeps the rounding
+//error far below that of multiplying it in n times
+template<typename Real>
+std::complex<Real> unitpower(std::complex<Real> base, size_t n)
+{
+	std::complex<Real> result(1,0);
+	while(n)
+	{
+		if(n & 1)
+			result *= base;
+		base *= base;
+		n >>= 1;
+	}
+	return result;
+}
+
+//Copies bytes from a block still in L1 to out with non-temporal stores where the processor
+//has them; the bytes before the first 16-byte boundary of out, and any after the last, are
+//copied normally
+inline void streamOut(void *out, const void *block, size_t bytes)
+{
+#ifdef __SSE2__
+	char *dst = (char *)out;
+	const char *src = (const char *)block;
+	size_t head = std::min(bytes, (16 - (reinterpret_cast<size_t>(dst) & 15)) & 15);
+	std::memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	bytes -= head;
+	for(;bytes >= 16;bytes-=16,dst+=16,src+=16)
+		_mm_stream_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+	std::memcpy(dst, src, bytes);
+#else
+	std::memcpy(out, block, bytes);
+#endif
+}
+
+//Orders non-temporal stores before anything that follows, such as pushing the output
+inline void streamFence()
+{
+#ifdef __SSE2__
+	_mm_sfence();
+#endif
+}
+
+//Numerically controlled oscillator that advances the phasor by complex multiplication
+struct RecurrenceNco
+{
+	template<typename Real>
+	static void forward(std::complex<Real> &current, const std::complex<Real> &deltaTheta) { current *= deltaTheta; }
+};
+
+//Special cases: shifts whose per-sample rotation is exact replace the oscillator with one
+//that never multiplies by deltaTheta and so never accumulates rounding error
+template<typename Nco>
+struct GeneralShift
+{
+	template<typename Real>
+	static void forward(std::complex<Real> &current, const std::complex<Real> &deltaTheta) { Nco::forward(current, deltaTheta); }
+};
+
+//No shift: the phasor never moves
+struct ZeroShift
+{
+	template<typename Real>
+	static void forward(std::complex<Real> &, const std::complex<Real> &) {}
+};
+
+//Shift by half the sample rate: the phasor changes sign every sample
+struct HalfRateShift
+{
+	template<typename Real>
+	static void forward(std::complex<Real> &current, const std::complex<Real> &) { current = -current; }
+};
+
+//Shift by a quarter of the sample rate: the phasor turns by j every sample
+struct QuarterRateShift
+{
+	template<typename Real>
+	static void forward(std::complex<Real> &current, const std::complex<Real> &) { current = std::complex<Real>(-current.imag(), current.real()); }
+};
+
+//Shift by three quarters of the sample rate: the phasor turns by -j every sample
+struct ThreeQuarterRateShift
+{
+	template<typename Real>
+	static void forward(std::complex<Real> &current, const std::complex<Real> &) { current = std::complex<Real>(current.imag(), -current.real()); }
+};
+
+//The general shift has a serial dependence from each sample's phasor to the next, which
+//keeps the compiler from vectorizing it. BlockRotation breaks it up: it shifts count samples
+//a block of four at a time, with one phasor per sample of the block, each advanced by
+//deltaTheta to the fourth power per block, so that conversion, shift and quantization of a
+//whole block run in SSE registers. It returns how many samples it shifted, and leaves phasor
+//at the next one for the caller to finish the rest. Without SSE2, in double precision and
+//for the special cases, which are exact one sample at a time, it shifts none
+template<typename InputSample, typename OutputSample, typename Real, typename SpecialCase>
+struct BlockRotation
+{
+	static size_t apply(const typename InputSample::element_type *, size_t, float, float,
+			std::complex<double> &, const std::complex<double> &, typename OutputSample::element_type *)
+	{
+		return 0;
+	}
+};
+
+#ifdef __SSE2__
+template<typename InputSample, typename OutputSample>
+struct BlockRotation<InputSample, OutputSample, float, GeneralShift<RecurrenceNco> >
+{
+	typedef typename InputSample::element_type Element;
+	typedef typename OutputSample::element_type OutputElement;
+
+	//deltaTheta to the fourth, rounded to float, turns each block by slightly the wrong angle,
+	//and the error would build up over a long packet. Instead the four phasors are set afresh
+	//every RESEED samples from the phase carried in double precision, so only the few float
+	//steps since then contribute
+	enum { RESEED = 64 };
+
+	//Samples are shifted one at a time until the output reaches a 16-byte boundary, as in the
+	//AVX kernels, so that the blocks can use aligned stores, and aligned loads as well when
+	//the input lines up the same way. Output that can never reach one, because it does not
+	//start on a whole sample, is written with unaligned stores throughout
+	static size_t apply(const Element *in, size_t count, float inputScale, float outputScale,
+			std::complex<double> &phasor, const std::complex<double> &deltaTheta, OutputElement *out)
+	{
+		size_t misalignment = reinterpret_cast<size_t>(out) & 15;
+		size_t head = (misalignment % OutputSample::size) ? 0 : ((16 - misalignment) & 15)/OutputSample::size;
+		if(count < head + 4)
+			return 0;
+		const size_t end = count - (count - head) % 4;
+
+		std::complex<float> current(phasor.real(), phasor.imag());
+		const std::complex<float> step(deltaTheta.real(), deltaTheta.imag());
+		for(size_t i=0;i<head;i++)
+		{
+			OutputSample::store(out, i, InputSample::shift(in, i, inputScale, current), outputScale);
+			current *= step;
+		}
+		if(head)
+			phasor *= unitpower(deltaTheta, head);
+
+		bool alignedOutput = ((reinterpret_cast<size_t>(out) + head*OutputSample::size) & 15) == 0;
+		bool alignedInput = ((reinterpret_cast<size_t>(in) + head*InputSample::size) & 15) == 0;
+		if(alignedOutput && alignedInput)
+			shiftBlocks<true, true>(in, head, end, inputScale, outputScale, phasor, deltaTheta, out);
+		else if(alignedOutput)
+			shiftBlocks<false, true>(in, head, end, inputScale, outputScale, phasor, deltaTheta, out);
+		else
+			shiftBlocks<false, false>(in, head, end, inputScale, outputScale, phasor, deltaTheta, out);
+
+		phasor *= unitpower(deltaTheta, end - head);
+		return end;
+	}
+
+	//Shifts samples begin to end, a whole number of blocks, starting from phasor
+	template<bool AlignedInput, bool AlignedOutput>
+	static void shiftBlocks(const Element *in, size_t begin, size_t end, float inputScale, float outputScale,
+			const std::complex<double> &phasor, const std::complex<double> &deltaTheta, OutputElement *out)
+	{
+		std::complex<double> offsets[4];
+		offsets[0] = 1;
+		for(size_t k=1;k<4;k++)
+			offsets[k] = offsets[k-1]*deltaTheta;
+		const std::complex<double> step = offsets[3]*deltaTheta;
+		const std::complex<double> reseed = unitpower(deltaTheta, RESEED);
+
+		const __m128 stepReal = _mm_set1_ps(step.real());
+		const __m128 stepImag = _mm_set1_ps(step.imag());
+		const __m128 inScale = _mm_set1_ps(inputScale);
+		const __m128 outScale = _mm_set1_ps(outputScale);
+		std::complex<double> base = phasor;
+
+		for(size_t i=begin;i<end;base*=reseed)
+		{
+			std::complex<double> lanes[4];
+			for(size_t k=0;k<4;k++)
+				lanes[k] = base*offsets[k];
+			__m128 currentReal = _mm_setr_ps(lanes[0].real(), lanes[1].real(), lanes[2].real(), lanes[3].real());
+			__m128 currentImag = _mm_setr_ps(lanes[0].imag(), lanes[1].imag(), lanes[2].imag(), lanes[3].imag());
+
+			for(size_t stop=std::min<size_t>(end, i + RESEED);i<stop;i+=4)
+			{
+				__m128 real, imag;
+				InputSample::template shift4<AlignedInput>(in, i, inScale, currentReal, currentImag, real, imag);
+				OutputSample::template store4<AlignedOutput>(out, i, real, imag, outScale);
+
+				__m128 next = _mm_sub_ps(_mm_mul_ps(currentReal, stepReal), _mm_mul_ps(currentImag, stepImag));
+				currentImag = _mm_add_ps(_mm_mul_ps(currentReal, stepImag), _mm_mul_ps(currentImag, stepReal));
+				currentReal = next;
+			}
+		}
+	}
+};
+#endif
+
+//The kernel family. InputSample is RealSample or ComplexSample of the received element
+//type, and OutputSample is ComplexOutput or QuantizedOutput of the sent element type
+template<typename InputSample, typename OutputSample, typename Nco, typename SpecialCase>
+struct FreqShifter
+{
+	typedef typename InputSample::element_type Element;
+	typedef typename OutputSample::element_type OutputElement;
+	typedef typename KernelPrecision<Element, OutputElement>::type Real;
+
+	static const ShiftKernel kernel;
+
+	//Forward rotation of count samples. BlockRotation takes as many as it can, and the rest
+	//are shifted one at a time in Real precision
+	static void rotate(const Element *in, size_t count, float inputScale, float outputScale,
+			std::complex<double> &phasor, const std::complex<double> &deltaTheta, OutputElement *out)
+	{
+		size_t i = BlockRotation<InputSample, OutputSample, Real, SpecialCase>::apply(in, count, inputScale, outputScale, phasor, deltaTheta, out);
+		if(i == count)
+			return;
+
+		std::complex<Real> current(phasor.real(), phasor.imag());
+		const std::complex<Real> step(deltaTheta.real(), deltaTheta.imag());
+		for(;i<count;i++)
+		{
+			OutputSample::store(out, i, InputSample::shift(in, i, inputScale, current), outputScale);
+			SpecialCase::forward(current, step);
+		}
+		phasor = std::complex<double>(current.real(), current.imag());
+	}
+
+	//Forward rotation of a large packet, STREAM_BLOCK samples at a time. Each block is shifted
+	//into a buffer on the stack, which stays in L1, and streamed out from there, while the
+	//input PREFETCH_BLOCKS blocks ahead is prefetched. The buffer is cache line aligned, so that
+	//the AVX kernels write it with aligned stores from its first sample
+	enum { STREAM_BLOCK = 256, PREFETCH_BLOCKS = 4, CACHE_LINE = 64 };
+
+	static void rotateStreaming(const Element *in, size_t count, float inputScale, float outputScale,
+			std::complex<double> &phasor, const std::complex<double> &deltaTheta, OutputElement *out)
+	{
+		OutputElement block[STREAM_BLOCK*OutputSample::size/sizeof(OutputElement)] __attribute__((aligned(CACHE_LINE)));
+		const char *input = (const char *)in;
+		char *output = (char *)out;
+		const size_t inputBytes = count*InputSample::size;
+
+		for(size_t begin=0;begin<count;begin+=STREAM_BLOCK)
+		{
+			size_t n = std::min<size_t>(STREAM_BLOCK, count - begin);
+			size_t ahead = (begin + PREFETCH_BLOCKS*STREAM_BLOCK)*InputSample::size;
+			size_t aheadEnd = std::min(inputBytes, ahead + STREAM_BLOCK*InputSample::size);
+			for(;ahead < aheadEnd;ahead+=CACHE_LINE)
+				__builtin_prefetch(input + ahead, 0, 0);
+
+			rotate((const Element *)(input + begin*InputSample::size), n, inputScale, outputScale, phasor, deltaTheta, block);
+			streamOut(output + begin*OutputSample::size, block, n*OutputSample::size);
+		}
+		streamFence();
+	}
+
+	static void apply(const void *input, size_t count, float inputScale, float outputScale,
+			std::complex<double> &phasor, const std::complex<double> &deltaTheta, void *output, bool streaming)
+	{
+		if(streaming)
+			rotateStreaming((const Element *)input, count, inputScale, outputScale, phasor, deltaTheta, (OutputElement *)output);
+		else
+			rotate((const Element *)input, count, inputScale, outputScale, phasor, deltaTheta, (OutputElement *)output);
+
+		phasor /= std::abs(phasor);
+	}
+
+	static void process(const void *input, size_t count, float inputScale, float outputScale,
+			std::complex<double> &phasor, const std::complex<double> &deltaTheta, void *output)
+	{
+		apply(input, count, inputScale, outputScale, phasor, deltaTheta, output, false);
+	}
+
+	static void processStreaming(const void *input, size_t count, float inputScale, float outputScale,
+			std::complex<double> &phasor, const std::complex<double> &deltaTheta, void *output)
+	{
+		apply(input, count, inputScale, outputScale, phasor, deltaTheta, output, true);
+	}
+
+	//Framed input is shifted in a single pass over the frames, with the phasors of a block of
+	//up to FRAME_BLOCK channels kept side by side so that they stay in L1 however many frames
+	//the packet holds. Wider frames take one pass per block. Every channel has its own shift,
+	//so the special cases never apply and the oscillator is always Nco
+	enum { FRAME_BLOCK = 64 };
+
+	static void processFramed(const void *input, size_t count, size_t channels, float inputScale, float outputScale,
+			const std::complex<double> *phasors, const std::complex<double> *deltaThetas, void *output)
+	{
+		const Element *in = (const Element *)input;
+		OutputElement *out = (OutputElement *)output;
+		std::complex<Real> current[FRAME_BLOCK];
+		std::complex<Real> step[FRAME_BLOCK];
+
+		for(size_t first=0;first<channels;first+=FRAME_BLOCK)
+		{
+			size_t width = std::min<size_t>(FRAME_BLOCK, channels - first);
+			for(size_t c=0;c<width;c++)
+			{
+				current[c] = std::complex<Real>(phasors[first+c].real(), phasors[first+c].imag());
+				step[c] = std::complex<Real>(deltaThetas[first+c].real(), deltaThetas[first+c].imag());
+			}
+
+			//base is the index of the block's first channel in each frame
+			for(size_t base=first;base<count;base+=channels)
+			{
+				size_t end = std::min(width, count - base);
+				for(size_t c=0;c<end;c++)
+				{
+					OutputSample::store(out, base+c, InputSample::shift(in, base+c, inputScale, current[c]), outputScale);
+					Nco::forward(current[c], step[c]);
+				}
+			}
+		}
+	}
+};
+
+template<typename InputSample, typename OutputSample, typename Nco, typename SpecialCase>
+const ShiftKernel FreqShifter<InputSample, OutputSample, Nco, SpecialCase>::kernel = {
+	InputSample::size,
+	OutputSample::size,
+	&FreqShifter<InputSample, OutputSample, Nco, SpecialCase>::process,
+	&FreqShifter<InputSample, OutputSample, Nco, SpecialCase>::processStreaming,
+	&FreqShifter<InputSample, OutputSample, Nco, SpecialCase>::processFramed
+};
+
+//Shifts a short float packet from each of up to LANES streams at once. The packets are
+//gathered into a structure-of-arrays block, with sample i of every lane side by side, so
+//that the rotation fills the SSE registers, four lanes to each, however short the packets
+//are and however their lengths differ. Every lane has its own phasor and deltaTheta. The
+//results are scattered back to each lane's output
+struct LaneShifter
+{
+	enum { LANES = 8, GROUPS = LANES/4 };
+
+	struct Lane
+	{
+		const float *input;
+		size_t count;			//samples
+		bool complexInput;
+		std::complex<double> phasor;	//phase of the first sample; not advanced
+		std::complex<double> deltaTheta;
+		std::complex<float> *output;	//may be the same as input when the input is complex
+	};
+
+	//Floats of scratch needed when the longest packet is count samples. The scratch must be
+	//16-byte aligned, as ScratchArena buffers are
+	static size_t scratchSize(size_t count) { return 2*LANES*count; }
+
+	static void process(const Lane *lanes, size_t laneCount, float *scratch);
+};
+
+#ifdef __AVX__
+//Multiplies the two complex doubles held in a by the two held in b
+inline __m256d avxmultiply(__m256d a, __m256d b)
+{
+	__m256d real = _mm256_movedup_pd(a);			//ar0 ar0 ar1 ar1
+	__m256d imag = _mm256_permute_pd(a, 0xF);		//ai0 ai0 ai1 ai1
+	__m256d swapped = _mm256_permute_pd(b, 0x5);		//bi0 br0 bi1 br1
+	return _mm256_addsub_pd(_mm256_mul_pd(real, b), _mm256_mul_pd(imag, swapped));
+}
+
+//Double precision rotation two samples at a time when built for AVX. The two lanes carry the
+//phasors of neighbouring samples and are each advanced by deltaTheta squared. Samples are
+//shifted one at a time until the output reaches a 32-byte boundary, so that the vector loop
+//can use aligned stores, and aligned loads as well when the input lines up the same way; an
+//odd sample at the end is finished with the scalar recurrence
+inline bool avxAligned(const void *p)
+{
+	return (reinterpret_cast<size_t>(p) & 31) == 0;
+}
+
+template<>
+inline void FreqShifter<ComplexSample<double>, ComplexOutput<double>, RecurrenceNco, GeneralShift<RecurrenceNco> >::rotate(
+		const double *in, size_t count, float, float,
+		std::complex<double> &phasor, const std::complex<double> &deltaTheta, std::complex<double> *out)
+{
+	std::complex<double> next = phasor;
+	size_t i = 0;
+	for(;i<count && !avxAligned(out + i);i++)
+	{
+		out[i] = std::complex<double>(in[2*i], in[2*i+1])*next;
+		next *= deltaTheta;
+	}
+
+	const std::complex<double> second = next*deltaTheta;
+	const std::complex<double> square = deltaTheta*deltaTheta;
+	__m256d current = _mm256_set_pd(second.imag(), second.real(), next.imag(), next.real());
+	const __m256d step = _mm256_set_pd(square.imag(), square.real(), square.imag(), square.real());
+
+	if(avxAligned(in + 2*i))
+	{
+		for(;i+2<=count;i+=2)
+		{
+			_mm256_store_pd((double *)(out + i), avxmultiply(_mm256_load_pd(in + 2*i), current));
+			current = avxmultiply(current, step);
+		}
+	}
+	else
+	{
+		for(;i+2<=count;i+=2)
+		{
+			_mm256_store_pd((double *)(out + i), avxmultiply(_mm256_loadu_pd(in + 2*i), current));
+			current = avxmultiply(current, step);
+		}
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, current);
+	next = std::complex<double>(lanes[0], lanes[1]);
+	for(;i<count;i++)
+	{
+		out[i] = std::complex<double>(in[2*i], in[2*i+1])*next;
+		next *= deltaTheta;
+	}
+	phasor = next;
+}
+
+template<>
+inline void FreqShifter<RealSample<double>, ComplexOutput<double>, RecurrenceNco, GeneralShift<RecurrenceNco> >::rotate(
+		const double *in, size_t count, float, float,
+		std::complex<double> &phasor, const std::complex<double> &deltaTheta, std::complex<double> *out)
+{
+	std::complex<double> next = phasor;
+	size_t i = 0;
+	for(;i<count && !avxAligned(out + i);i++)
+	{
+		out[i] = next*in[i];
+		next *= deltaTheta;
+	}
+
+	const std::complex<double> second = next*deltaTheta;
+	const std::complex<double> square = deltaTheta*deltaTheta;
+	__m256d current = _mm256_set_pd(second.imag(), second.real(), next.imag(), next.real());
+	const __m256d step = _mm256_set_pd(square.imag(), square.real(), square.imag(), square.real());
+
+	for(;i+2<=count;i+=2)
+	{
+		__m256d x = _mm256_set_pd(in[i+1], in[i+1], in[i], in[i]);
+		_mm256_store_pd((double *)(out + i), _mm256_mul_pd(x, current));
+		current = avxmultiply(current, step);
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, current);
+	next = std::complex<double>(lanes[0], lanes[1]);
+	for(;i<count;i++)
+	{
+		out[i] = next*in[i];
+		next *= deltaTheta;
+	}
+	phasor = next;
+}
+#endif
+
+#endif // FREQSHIFTER_H
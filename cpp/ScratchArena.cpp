@@ -0,0 +1,165 @@
+/*
+* Copyright (C) 2015 Axios, Inc.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ScratchArena.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+
+size_t ScratchArena::allBytes = 0;
+size_t ScratchArena::allHugePages = 0;
+bool ScratchArena::hugePages = false;
+
+//Maps bytes (a whole number of huge pages) of anonymous memory, from the reserved huge page
+//pool if it has enough free pages and otherwise as ordinary pages aligned to a huge page and
+//marked for transparent huge pages. Returns NULL when nothing could be mapped; pages is set
+//to the number of reserved huge pages used
+static void *mapHugePages(size_t bytes, size_t &pages)
+{
+	pages = 0;
+	void *data;
+#ifdef MAP_HUGETLB
+	data = mmap(NULL, bytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+	if(data != MAP_FAILED)
+	{
+		pages = bytes/ScratchArena::HUGE_PAGE_SIZE;
+		return data;
+	}
+#endif
+
+	//Transparent huge pages only back ranges aligned to a huge page, so a page more than
+	//needed is mapped and the ends trimmed off
+	size_t span = bytes + ScratchArena::HUGE_PAGE_SIZE;
+	data = mmap(NULL, span, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if(data == MAP_FAILED)
+		return NULL;
+
+	char *raw = (char *)data;
+	char *aligned = (char *)(((size_t)raw + ScratchArena::HUGE_PAGE_SIZE - 1) & ~(size_t)(ScratchArena::HUGE_PAGE_SIZE - 1));
+	if(aligned > raw)
+		munmap(raw, aligned - raw);
+	if(raw + span > aligned + bytes)
+		munmap(aligned + bytes, (raw + span) - (aligned + bytes));
+#ifdef MADV_HUGEPAGE
+	madvise(aligned, bytes, MADV_HUGEPAGE);
+#endif
+	return aligned;
+}
+
+ScratchArena::ScratchArena() : shrink(false)
+{
+}
+
+ScratchArena::ScratchArena(const ScratchArena &other) : shrink(other.shrink)
+{
+}
+
+ScratchArena &ScratchArena::operator=(const ScratchArena &other)
+{
+	if(this != &other)
+	{
+		release();
+		shrink = other.shrink;
+	}
+	return *this;
+}
+
+ScratchArena::~ScratchArena()
+{
+	release();
+}
+
+void ScratchArena::release()
+{
+	for(unsigned int i=0;i<SLOTS;i++)
+		resize(slots[i], 0, 0);
+}
+
+size_t ScratchArena::bytes() const
+{
+	size_t total = 0;
+	for(unsigned int i=0;i<SLOTS;i++)
+		total += slots[i].capacity;
+	return total;
+}
+
+void *ScratchArena::reserve(unsigned int index, size_t bytes, size_t preserve)
+{
+	Slot &slot = slots[index];
+
+	if(bytes > slot.capacity)
+		resize(slot, bytes, preserve);
+
+	if(bytes > slot.peak)
+		slot.peak = bytes;
+
+	//Every SHRINK_PERIOD requests, a slot more than twice the size of anything asked of it
+	//during that period is trimmed back to the period's high-water mark
+	if(++slot.requests == SHRINK_PERIOD)
+	{
+		if(shrink && slot.capacity > 2*slot.peak)
+			resize(slot, slot.peak, std::min(preserve, slot.peak));
+		slot.peak = 0;
+		slot.requests = 0;
+	}
+
+	return slot.data;
+}
+
+void ScratchArena::resize(Slot &slot, size_t bytes, size_t preserve)
+{
+	void *data = 0;
+	size_t pages = 0;
+	bool mapped = false;
+	if(bytes)
+	{
+		//Slots of at least half a huge page are rounded up to whole huge pages and mapped when
+		//huge pages are enabled; everything else, and any slot that cannot be mapped, comes
+		//from the heap with capacity rounded up to whole alignment blocks
+		if(hugePages && bytes >= HUGE_PAGE_SIZE/2)
+		{
+			bytes = (bytes + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+			data = mapHugePages(bytes, pages);
+			mapped = (data != 0);
+		}
+		if(!data)
+		{
+			bytes = (bytes + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+			if(posix_memalign(&data, ALIGNMENT, bytes))
+				throw std::bad_alloc();
+		}
+		AllocationCounter::record();
+		if(preserve && slot.data)
+			memcpy(data, slot.data, std::min(preserve, slot.capacity));
+	}
+
+	if(slot.mapped)
+		munmap(slot.data, slot.capacity);
+	else
+		free(slot.data);
+	allBytes -= slot.capacity;
+	allBytes += bytes;
+	allHugePages -= slot.hugePages;
+	allHugePages += pages;
+	slot.data = data;
+	slot.capacity = bytes;
+	slot.hugePages = pages;
+	slot.mapped = mapped;
+}
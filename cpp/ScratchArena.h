@@ -0,0 +1,92 @@
+/*
+* Copyright (C) 2015 Axios, Inc.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCRATCHARENA_H
+#define SCRATCHARENA_H
+
+#include <cstddef>
+
+//A small set of reusable, 64-byte aligned scratch buffers owned by one stream. Each slot
+//grows to the largest size requested of it and is then reused, so once a stream reaches
+//its high-water mark no further allocations are made. With shrinking enabled, a slot that
+//has been much larger than recent requests is periodically trimmed back down.
+//
+//With huge pages enabled, slots of at least half a huge page are mapped directly, backed by
+//reserved 2 MB pages when the system has them free and by transparent huge pages otherwise,
+//falling back to the heap when neither can be mapped.
+//
+//Copies of an arena start out empty; scratch memory is never shared between arenas.
+class ScratchArena
+{
+public:
+	enum { SLOTS = 4, ALIGNMENT = 64, HUGE_PAGE_SIZE = 2*1024*1024 };
+
+	ScratchArena();
+	ScratchArena(const ScratchArena &other);
+	ScratchArena &operator=(const ScratchArena &other);
+	~ScratchArena();
+
+	//Returns slot as a buffer of at least count elements of T. When the slot has to grow,
+	//the first preserve elements of its previous contents are carried over
+	template<typename T>
+	T *get(unsigned int slot, size_t count, size_t preserve = 0)
+	{
+		return (T *)reserve(slot, count*sizeof(T), preserve*sizeof(T));
+	}
+
+	//Enables trimming of slots that have been oversized for the last SHRINK_PERIOD requests
+	void setShrink(bool enabled) { shrink = enabled; }
+
+	//Releases every slot
+	void release();
+
+	//Bytes currently held by this arena, and by all arenas in the process
+	size_t bytes() const;
+	static size_t totalBytes() { return allBytes; }
+
+	//Enables huge pages for slots grown from now on, in every arena
+	static void setHugePages(bool enabled) { hugePages = enabled; }
+
+	//Reserved huge pages currently held by all arenas in the process
+	static size_t totalHugePages() { return allHugePages; }
+
+private:
+	enum { SHRINK_PERIOD = 256 };
+
+	struct Slot
+	{
+		Slot() : data(0), capacity(0), hugePages(0), mapped(false), peak(0), requests(0) {}
+		void *data;
+		size_t capacity;	//bytes allocated
+		size_t hugePages;	//reserved huge pages backing data
+		bool mapped;		//data was mapped rather than taken from the heap
+		size_t peak;		//largest request since the slot was last checked for trimming
+		unsigned int requests;	//requests since the slot was last checked for trimming
+	};
+
+	void *reserve(unsigned int slot, size_t bytes, size_t preserve);
+	void resize(Slot &slot, size_t bytes, size_t preserve);
+
+	Slot slots[SLOTS];
+	bool shrink;
+
+	static size_t allBytes;
+	static size_t allHugePages;
+	static bool hugePages;
+};
+
+#endif // SCRATCHARENA_H
@@ -0,0 +1,192 @@
+/*
+* Copyright (C) 2015 Axios, Inc.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STREAMTABLE_H
+#define STREAMTABLE_H
+
+#include <string>
+#include <vector>
+
+//Bookkeeping every context kept in a StreamTable carries. The stream ID is stored once,
+//here, and lookups compare against it without building any temporary strings.
+struct StreamTableEntry
+{
+	StreamTableEntry() : hash(0), newer(0), older(0) {}
+
+	std::string streamID;
+	size_t hash;
+	StreamTableEntry *newer;	//neighbours in least-recently-used order
+	StreamTableEntry *older;
+};
+
+//Per-stream contexts in an open-addressing hash table keyed by stream ID. Packets tend to
+//arrive in runs from the same stream, so the most recently used context is checked before
+//hashing. Contexts are also kept in least-recently-used order so that the owner can walk
+//them, or choose one to evict, without touching the table itself.
+//
+//Context must derive from StreamTableEntry and be default constructible.
+template<typename Context>
+class StreamTable
+{
+public:
+	StreamTable() : slots(16, (Context *)0), count(0), newest(0), oldest(0) {}
+
+	~StreamTable()
+	{
+		for(size_t i=0;i<slots.size();i++)
+			delete slots[i];
+	}
+
+	//Returns the context for streamID, or NULL if there is none. A context that is found
+	//becomes the most recently used
+	Context *find(const std::string &streamID)
+	{
+		if(newest && newest->streamID == streamID)
+			return static_cast<Context *>(newest);
+
+		size_t hash = hashOf(streamID);
+		for(size_t i=hash & mask();slots[i];i=(i + 1) & mask())
+		{
+			if(slots[i]->hash == hash && slots[i]->streamID == streamID)
+			{
+				touch(slots[i]);
+				return slots[i];
+			}
+		}
+		return 0;
+	}
+
+	//Creates a context for streamID, which must not already have one. The new context
+	//becomes the most recently used
+	Context *insert(const std::string &streamID)
+	{
+		if(4*(count + 1) > 3*slots.size())
+			rehash(2*slots.size());
+
+		Context *context = new Context();
+		context->streamID = streamID;
+		context->hash = hashOf(streamID);
+		place(context);
+		count++;
+
+		link(context);
+		return context;
+	}
+
+	//Destroys a context
+	void erase(Context *context)
+	{
+		size_t i = context->hash & mask();
+		while(slots[i] != context)
+			i = (i + 1) & mask();
+
+		//Backward-shift deletion: entries after the hole that would no longer be reachable
+		//from their home slot are moved up into it, so no tombstones are needed
+		slots[i] = 0;
+		for(size_t j=(i + 1) & mask();slots[j];j=(j + 1) & mask())
+		{
+			size_t home = slots[j]->hash & mask();
+			bool reachable = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+			if(!reachable)
+			{
+				slots[i] = slots[j];
+				slots[j] = 0;
+				i = j;
+			}
+		}
+
+		unlink(context);
+		count--;
+		delete context;
+	}
+
+	size_t size() const { return count; }
+
+	//Walks the contexts from least to most recently used
+	Context *leastRecent() const { return static_cast<Context *>(oldest); }
+	Context *newerThan(const Context *context) const { return static_cast<Context *>(context->newer); }
+
+private:
+	static size_t hashOf(const std::string &streamID)
+	{
+		//FNV-1a
+		size_t hash = 2166136261u;
+		for(size_t i=0;i<streamID.size();i++)
+			hash = (hash ^ (unsigned char)streamID[i])*16777619u;
+		return hash;
+	}
+
+	size_t mask() const { return slots.size() - 1; }
+
+	void place(Context *context)
+	{
+		size_t i = context->hash & mask();
+		while(slots[i])
+			i = (i + 1) & mask();
+		slots[i] = context;
+	}
+
+	void rehash(size_t capacity)
+	{
+		std::vector<Context *> previous(capacity, (Context *)0);
+		slots.swap(previous);
+		for(size_t i=0;i<previous.size();i++)
+		{
+			if(previous[i])
+				place(previous[i]);
+		}
+	}
+
+	void link(StreamTableEntry *entry)
+	{
+		entry->older = newest;
+		entry->newer = 0;
+		if(newest)
+			newest->newer = entry;
+		newest = entry;
+		if(!oldest)
+			oldest = entry;
+	}
+
+	void unlink(StreamTableEntry *entry)
+	{
+		if(entry->newer)
+			entry->newer->older = entry->older;
+		else
+			newest = entry->older;
+		if(entry->older)
+			entry->older->newer = entry->newer;
+		else
+			oldest = entry->newer;
+	}
+
+	void touch(StreamTableEntry *entry)
+	{
+		if(entry != newest)
+		{
+			unlink(entry);
+			link(entry);
+		}
+	}
+
+	std::vector<Context *> slots;	//power of two in size, never more than 3/4 full
+	size_t count;
+	StreamTableEntry *newest;
+	StreamTableEntry *oldest;
+};
+
+#endif // STREAMTABLE_H
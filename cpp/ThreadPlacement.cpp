@@ -0,0 +1,203 @@
+/*
+* Copyright (C) 2015 Axios, Inc.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThreadPlacement.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <alloca.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+namespace
+{
+	//Bits in the node mask handed to the memory policy calls. The kernel reads one bit fewer
+	//than it is told, so only nodes below NODE_BITS - 1 can be named
+	const unsigned long NODE_BITS = 8*sizeof(unsigned long);
+
+	//Parses a cpulist into set, returning false on anything malformed
+	bool parseCpuList(const std::string &list, cpu_set_t &set)
+	{
+		CPU_ZERO(&set);
+		std::stringstream ranges(list);
+		std::string range;
+		bool any = false;
+		while(std::getline(ranges, range, ','))
+		{
+			range.erase(0, range.find_first_not_of(" \t\n"));
+			range.erase(range.find_last_not_of(" \t\n") + 1);
+			if(range.empty())
+				continue;
+
+			char *end;
+			long first = strtol(range.c_str(), &end, 10);
+			long last = first;
+			if(*end == '-')
+				last = strtol(end + 1, &end, 10);
+			if(*end || first < 0 || last < first || last >= CPU_SETSIZE)
+				return false;
+			for(long cpu=first;cpu<=last;cpu++)
+				CPU_SET(cpu, &set);
+			any = true;
+		}
+		return any;
+	}
+
+	//Formats set as a cpulist
+	std::string formatCpuList(const cpu_set_t &set)
+	{
+		std::ostringstream list;
+		for(int cpu=0;cpu<CPU_SETSIZE;cpu++)
+		{
+			if(!CPU_ISSET(cpu, &set))
+				continue;
+			int last = cpu;
+			while(last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &set))
+				last++;
+			if(list.tellp() > 0)
+				list << ",";
+			list << cpu;
+			if(last > cpu)
+				list << "-" << last;
+			cpu = last;
+		}
+		return list.str();
+	}
+}
+
+std::string ThreadPlacement::nodeCpus(int node)
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+	std::ifstream file(path);
+	std::string list;
+	std::getline(file, list);
+	return list;
+}
+
+std::string ThreadPlacement::allCpus()
+{
+	std::ostringstream list;
+	list << "0-" << std::max(sysconf(_SC_NPROCESSORS_CONF) - 1, 0L);
+	return list.str();
+}
+
+bool ThreadPlacement::bindCpus(const std::string &list)
+{
+	cpu_set_t set;
+	if(!parseCpuList(list, set))
+		return false;
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+bool ThreadPlacement::preferNode(int node)
+{
+	if(node < 0)
+		return syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0) == 0;
+	if((unsigned long)node >= NODE_BITS - 1)
+		return false;
+
+	unsigned long mask = 1UL << node;
+	return syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, NODE_BITS) == 0;
+}
+
+bool ThreadPlacement::setScheduling(const std::string &policy, int priority)
+{
+	struct sched_param param;
+	param.sched_priority = 0;
+	int value = SCHED_OTHER;
+	if(policy == "SCHED_FIFO" || policy == "SCHED_RR")
+	{
+		value = (policy == "SCHED_FIFO") ? SCHED_FIFO : SCHED_RR;
+		param.sched_priority = std::min(std::max(priority, sched_get_priority_min(value)), sched_get_priority_max(value));
+	}
+	else if(policy != "SCHED_OTHER")
+		return false;
+
+	return pthread_setschedparam(pthread_self(), value, &param) == 0;
+}
+
+bool ThreadPlacement::lockMemory(bool locked)
+{
+	if(locked)
+		return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+	return munlockall() == 0;
+}
+
+void ThreadPlacement::prefaultStack(size_t bytes)
+{
+	volatile char *stack = (volatile char *)alloca(bytes);
+	size_t page = sysconf(_SC_PAGESIZE);
+	for(size_t i=0;i<bytes;i+=page)
+		stack[i] = 0;
+}
+
+std::string ThreadPlacement::describe()
+{
+	std::ostringstream description;
+
+	cpu_set_t set;
+	if(pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+		description << "cpus " << formatCpuList(set);
+	else
+		description << "cpus unknown";
+
+	int mode;
+	unsigned long mask = 0;
+	if(syscall(SYS_get_mempolicy, &mode, &mask, NODE_BITS, NULL, 0) != 0)
+		description << "; memory policy unknown";
+	else if(mode == MPOL_PREFERRED && mask)
+	{
+		int node = 0;
+		while(!(mask & (1UL << node)))
+			node++;
+		description << "; memory preferred on node " << node;
+	}
+	else
+		description << "; memory local to the running cpu";
+
+	int policy;
+	struct sched_param param;
+	if(pthread_getschedparam(pthread_self(), &policy, &param) != 0)
+		description << "; scheduling unknown";
+	else if(policy == SCHED_FIFO || policy == SCHED_RR)
+		description << "; " << (policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_RR") << " priority " << param.sched_priority;
+	else
+		description << "; SCHED_OTHER";
+
+	//The locked total is only reported by the kernel in the process status
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while(std::getline(status, line))
+	{
+		if(line.compare(0, 6, "VmLck:") == 0)
+		{
+			std::istringstream fields(line.substr(6));
+			unsigned long kB = 0;
+			fields >> kB;
+			description << "; " << kB << " kB locked";
+		}
+	}
+
+	return description.str();
+}
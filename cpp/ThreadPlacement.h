@@ -0,0 +1,61 @@
+/*
+* Copyright (C) 2015 Axios, Inc.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREADPLACEMENT_H
+#define THREADPLACEMENT_H
+
+#include <cstddef>
+#include <string>
+
+//Placement of the calling thread on CPUs and NUMA nodes, and its scheduling. Everything here
+//but memory locking applies to the thread that calls it, so it is meant to be called from the
+//processing thread itself. CPU lists use the kernel's cpulist form, such as "0-7,16-23".
+class ThreadPlacement
+{
+public:
+	//CPUs of a NUMA node, or an empty string when the node does not exist
+	static std::string nodeCpus(int node);
+
+	//Every CPU configured in the system
+	static std::string allCpus();
+
+	//Restricts the calling thread to the CPUs in list. Returns false when the list cannot be
+	//parsed or the affinity cannot be set
+	static bool bindCpus(const std::string &list);
+
+	//Makes node the preferred node for memory first touched by the calling thread, or
+	//restores the default policy of allocating on the local node when node is negative
+	static bool preferNode(int node);
+
+	//Sets the scheduling policy of the calling thread: "SCHED_OTHER", or "SCHED_FIFO" or
+	//"SCHED_RR" at the given real-time priority
+	static bool setScheduling(const std::string &policy, int priority);
+
+	//Locks all of the process's current and future pages into memory, so that none of them
+	//is ever paged out or faulted in later, or unlocks them
+	static bool lockMemory(bool locked);
+
+	//Touches bytes of the calling thread's stack so that its pages are faulted in now
+	static void prefaultStack(size_t bytes);
+
+	//Describes the calling thread's CPU affinity, memory policy and scheduling, and how much
+	//of the process's memory is locked, for example
+	//"cpus 8-15; memory preferred on node 1; SCHED_FIFO priority 50; 81920 kB locked"
+	static std::string describe();
+};
+
+#endif // THREADPLACEMENT_H
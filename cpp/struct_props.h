@@ -0,0 +1,254 @@
+/*
+* Copyright (C) 2015 Axios, Inc.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef STRUCTPROPS_H
+#define STRUCTPROPS_H
+
+/*******************************************************************************************
+
+    AUTO-GENERATED CODE. DO NOT MODIFY
+
+*******************************************************************************************/
+
+#include <ossie/CorbaUtils.h>
+
+struct stream_priority_struct {
+    stream_priority_struct ()
+    {
+        priority = 0;
+    };
+
+    std::string getId() {
+        return std::string("stream_priority");
+    };
+
+    std::string stream_id;
+    short priority;
+};
+
+inline bool operator>>= (const CORBA::Any& a, stream_priority_struct& s) {
+    CF::Properties* temp;
+    if (!(a >>= temp)) return false;
+    CF::Properties& props = *temp;
+    for (unsigned int idx = 0; idx < props.length(); idx++) {
+        if (!strcmp("stream_priority::stream_id", props[idx].id)) {
+            if (!(props[idx].value >>= s.stream_id)) return false;
+        }
+        else if (!strcmp("stream_priority::priority", props[idx].id)) {
+            if (!(props[idx].value >>= s.priority)) return false;
+        }
+    }
+    return true;
+};
+
+inline void operator<<= (CORBA::Any& a, const stream_priority_struct& s) {
+    CF::Properties props;
+    props.length(2);
+    props[0].id = CORBA::string_dup("stream_priority::stream_id");
+    props[0].value <<= s.stream_id;
+    props[1].id = CORBA::string_dup("stream_priority::priority");
+    props[1].value <<= s.priority;
+    a <<= props;
+};
+
+inline bool operator== (const stream_priority_struct& s1, const stream_priority_struct& s2) {
+    if (s1.stream_id!=s2.stream_id)
+        return false;
+    if (s1.priority!=s2.priority)
+        return false;
+    return true;
+};
+
+inline bool operator!= (const stream_priority_struct& s1, const stream_priority_struct& s2) {
+    return !(s1==s2);
+};
+
+struct priority_latency_entry_struct {
+    priority_latency_entry_struct ()
+    {
+    };
+
+    std::string getId() {
+        return std::string("priority_latency_entry");
+    };
+
+    short priority;
+    CORBA::ULong packets;
+    double average_latency;
+    double max_latency;
+};
+
+inline bool operator>>= (const CORBA::Any& a, priority_latency_entry_struct& s) {
+    CF::Properties* temp;
+    if (!(a >>= temp)) return false;
+    CF::Properties& props = *temp;
+    for (unsigned int idx = 0; idx < props.length(); idx++) {
+        if (!strcmp("priority_latency_entry::priority", props[idx].id)) {
+            if (!(props[idx].value >>= s.priority)) return false;
+        }
+        else if (!strcmp("priority_latency_entry::packets", props[idx].id)) {
+            if (!(props[idx].value >>= s.packets)) return false;
+        }
+        else if (!strcmp("priority_latency_entry::average_latency", props[idx].id)) {
+            if (!(props[idx].value >>= s.average_latency)) return false;
+        }
+        else if (!strcmp("priority_latency_entry::max_latency", props[idx].id)) {
+            if (!(props[idx].value >>= s.max_latency)) return false;
+        }
+    }
+    return true;
+};
+
+inline void operator<<= (CORBA::Any& a, const priority_latency_entry_struct& s) {
+    CF::Properties props;
+    props.length(4);
+    props[0].id = CORBA::string_dup("priority_latency_entry::priority");
+    props[0].value <<= s.priority;
+    props[1].id = CORBA::string_dup("priority_latency_entry::packets");
+    props[1].value <<= s.packets;
+    props[2].id = CORBA::string_dup("priority_latency_entry::average_latency");
+    props[2].value <<= s.average_latency;
+    props[3].id = CORBA::string_dup("priority_latency_entry::max_latency");
+    props[3].value <<= s.max_latency;
+    a <<= props;
+};
+
+inline bool operator== (const priority_latency_entry_struct& s1, const priority_latency_entry_struct& s2) {
+    if (s1.priority!=s2.priority)
+        return false;
+    if (s1.packets!=s2.packets)
+        return false;
+    if (s1.average_latency!=s2.average_latency)
+        return false;
+    if (s1.max_latency!=s2.max_latency)
+        return false;
+    return true;
+};
+
+inline bool operator!= (const priority_latency_entry_struct& s1, const priority_latency_entry_struct& s2) {
+    return !(s1==s2);
+};
+
+struct stream_frequency_struct {
+    stream_frequency_struct ()
+    {
+        frequency = 0;
+    };
+
+    std::string getId() {
+        return std::string("stream_frequency");
+    };
+
+    std::string stream_id;
+    float frequency;
+};
+
+inline bool operator>>= (const CORBA::Any& a, stream_frequency_struct& s) {
+    CF::Properties* temp;
+    if (!(a >>= temp)) return false;
+    CF::Properties& props = *temp;
+    for (unsigned int idx = 0; idx < props.length(); idx++) {
+        if (!strcmp("stream_frequency::stream_id", props[idx].id)) {
+            if (!(props[idx].value >>= s.stream_id)) return false;
+        }
+        else if (!strcmp("stream_frequency::frequency", props[idx].id)) {
+            if (!(props[idx].value >>= s.frequency)) return false;
+        }
+    }
+    return true;
+};
+
+inline void operator<<= (CORBA::Any& a, const stream_frequency_struct& s) {
+    CF::Properties props;
+    props.length(2);
+    props[0].id = CORBA::string_dup("stream_frequency::stream_id");
+    props[0].value <<= s.stream_id;
+    props[1].id = CORBA::string_dup("stream_frequency::frequency");
+    props[1].value <<= s.frequency;
+    a <<= props;
+};
+
+inline bool operator== (const stream_frequency_struct& s1, const stream_frequency_struct& s2) {
+    if (s1.stream_id!=s2.stream_id)
+        return false;
+    if (s1.frequency!=s2.frequency)
+        return false;
+    return true;
+};
+
+inline bool operator!= (const stream_frequency_struct& s1, const stream_frequency_struct& s2) {
+    return !(s1==s2);
+};
+
+struct connection_descriptor_struct {
+    connection_descriptor_struct ()
+    {
+    };
+
+    std::string getId() {
+        return std::string("connectionTable::connection_descriptor");
+    };
+
+    std::string connection_id;
+    std::string stream_id;
+    std::string port_name;
+};
+
+inline bool operator>>= (const CORBA::Any& a, connection_descriptor_struct& s) {
+    CF::Properties* temp;
+    if (!(a >>= temp)) return false;
+    CF::Properties& props = *temp;
+    for (unsigned int idx = 0; idx < props.length(); idx++) {
+        if (!strcmp("connectionTable::connection_id", props[idx].id)) {
+            if (!(props[idx].value >>= s.connection_id)) return false;
+        }
+        else if (!strcmp("connectionTable::stream_id", props[idx].id)) {
+            if (!(props[idx].value >>= s.stream_id)) return false;
+        }
+        else if (!strcmp("connectionTable::port_name", props[idx].id)) {
+            if (!(props[idx].value >>= s.port_name)) return false;
+        }
+    }
+    return true;
+};
+
+inline void operator<<= (CORBA::Any& a, const connection_descriptor_struct& s) {
+    CF::Properties props;
+    props.length(3);
+    props[0].id = CORBA::string_dup("connectionTable::connection_id");
+    props[0].value <<= s.connection_id;
+    props[1].id = CORBA::string_dup("connectionTable::stream_id");
+    props[1].value <<= s.stream_id;
+    props[2].id = CORBA::string_dup("connectionTable::port_name");
+    props[2].value <<= s.port_name;
+    a <<= props;
+};
+
+inline bool operator== (const connection_descriptor_struct& s1, const connection_descriptor_struct& s2) {
+    if (s1.connection_id!=s2.connection_id)
+        return false;
+    if (s1.stream_id!=s2.stream_id)
+        return false;
+    if (s1.port_name!=s2.port_name)
+        return false;
+    return true;
+};
+
+inline bool operator!= (const connection_descriptor_struct& s1, const connection_descriptor_struct& s2) {
+    return !(s1==s2);
+};
+
+#endif // STRUCTPROPS_H
@@ -17,8 +17,9 @@ import unittest
 import ossie.utils.testing
 from ossie.utils import sb
 import os
-from time import sleep
+from time import sleep, time
 from omniORB import any
+from bulkio.bulkioInterfaces import BULKIO
 import math
 from scipy.odr.odrpack import Output
 
@@ -182,6 +183,364 @@ class ResourceTests(ossie.utils.testing.ScaComponentTestCase):
             
             self.assertEqual(round(outData[2*x], 3), resultReal)
             self.assertEqual(round(outData[2*x+1], 3), resultImag)
+
+    def serviceOrder(self, starvationLimit):
+        #Queues a packet of a low and then a high priority stream while the component is
+        #stopped, and returns the values of the output in the order it was pushed
+        self.comp.frequency_shift = 0
+        self.comp.starvation_limit = starvationLimit
+        self.comp.stream_priorities = [{"stream_priority::stream_id": "low", "stream_priority::priority": 0},
+                                       {"stream_priority::stream_id": "high", "stream_priority::priority": 5}]
+        self.comp.stop()
+        self.src.push([1.0, 0.0]*10, streamID = "low", complexData = True, sampleRate = 1000.0)
+        self.src.push([2.0, 0.0]*10, streamID = "high", complexData = True, sampleRate = 1000.0)
+        sleep(0.5)
+        self.comp.start()
+
+        outData = []
+        for count in xrange(2000):
+            outData += self.sink.getData()
+            if len(outData) >= 40:
+                break
+            sleep(.01)
+        self.assertEqual(len(outData), 40)
+        return [round(x) for x in outData[0::2]]
+
+    def testPriorityOrder(self):
+        print "Testing that the higher priority stream is serviced first"
+
+        order = self.serviceOrder(starvationLimit = 10000)
+        self.assertEqual(order, [2.0]*10 + [1.0]*10)
+
+    def testStarvationLimit(self):
+        print "Testing that a packet waiting past starvation_limit goes first regardless of priority"
+
+        order = self.serviceOrder(starvationLimit = 1)
+        self.assertEqual(order, [1.0]*10 + [2.0]*10)
+
+    def testCoalescedOutputFlushedOnLatency(self):
+        print "Testing that coalesced output is pushed once coalesce_latency expires"
+
+        self.comp.coalesce_size = 100000
+        self.comp.coalesce_latency = 50
+        pushed = time()
+        inputData, outData = self.initialize(False, 200)
+        elapsed = time() - pushed
+
+        self.assertEqual(len(inputData)*2, len(outData))
+        self.assertTrue(elapsed >= 0.05)
+        self.assertTrue(elapsed < 0.3)
+
+    def testSplitOutputIsContinuous(self):
+        print "Testing that output split by max_output_packet_size stays phase continuous"
+
+        self.comp.max_output_packet_size = 3
+        inputData, outData = self.initialize(False, 200)
+
+        self.assertEqual(len(inputData)*2, len(outData))
+        for x in range(len(inputData)):
+            resultReal = inputData[x] * math.cos(2.0*math.pi*x*self.comp.frequency_shift/1000.0)
+            resultImag = inputData[x] * math.sin(2.0*math.pi*x*self.comp.frequency_shift/1000.0)
+            self.assertEqual(round(outData[2*x], 3), round(resultReal, 3))
+            self.assertEqual(round(outData[2*x+1], 3), round(resultImag, 3))
+
+    def assertShifted(self, inputData, outData, shift, first = 0, complexData = False):
+        #Checks outData against inputData shifted by shift Hz at a sample rate of 1000, with
+        #the first sample at index first of its stream
+        samples = len(inputData)/2 if complexData else len(inputData)
+        self.assertEqual(len(outData), 2*samples)
+        for x in range(samples):
+            phase = 2.0*math.pi*(x + first)*shift/1000.0
+            if complexData:
+                resultReal = inputData[2*x]*math.cos(phase) - inputData[2*x+1]*math.sin(phase)
+                resultImag = inputData[2*x]*math.sin(phase) + inputData[2*x+1]*math.cos(phase)
+            else:
+                resultReal = inputData[x]*math.cos(phase)
+                resultImag = inputData[x]*math.sin(phase)
+            self.assertEqual(round(outData[2*x], 3), round(resultReal, 3))
+            self.assertEqual(round(outData[2*x+1], 3), round(resultImag, 3))
+
+    def activeStreams(self, expected):
+        #Waits for active_streams to reach expected and returns its last value
+        for count in xrange(200):
+            active = self.comp.active_streams
+            if active == expected:
+                break
+            sleep(.01)
+        return active
+
+    def testStreamReclaimedOnEOS(self):
+        print "Testing that a stream's state is released once its end of stream is processed"
+
+        self.comp.frequency_shift = 200
+        inputData = [float(x + 1) for x in xrange(10)]
+        self.src.push(inputData, streamID = "s", complexData = False, sampleRate = 1000.0)
+        self.assertShifted(inputData, self.receive(self.sink, 20), 200)
+        self.assertEqual(self.activeStreams(1), 1)
+
+        self.src.push(inputData, EOS = True, streamID = "s", complexData = False, sampleRate = 1000.0)
+        self.assertShifted(inputData, self.receive(self.sink, 20), 200, first = 10)
+        self.assertEqual(self.activeStreams(0), 0)
+
+    def testLeastRecentStreamEvicted(self):
+        print "Testing that max_streams evicts the least recently used stream and keeps the others"
+
+        self.comp.frequency_shift = 30
+        self.comp.max_streams = 2
+        inputData = [float(x + 1) for x in xrange(10)]
+        for streamID in ("a", "b", "c"):
+            self.src.push(inputData, streamID = streamID, complexData = False, sampleRate = 1000.0)
+            self.assertShifted(inputData, self.receive(self.sink, 20), 30)
+        self.assertEqual(self.activeStreams(2), 2)
+
+        #"a" was evicted to make room for "c", so "b" and "c" carry on from their phase while
+        #"a" starts again from zero
+        self.src.push(inputData, streamID = "c", complexData = False, sampleRate = 1000.0)
+        self.assertShifted(inputData, self.receive(self.sink, 20), 30, first = 10)
+        self.src.push(inputData, streamID = "b", complexData = False, sampleRate = 1000.0)
+        self.assertShifted(inputData, self.receive(self.sink, 20), 30, first = 10)
+        self.src.push(inputData, streamID = "a", complexData = False, sampleRate = 1000.0)
+        self.assertShifted(inputData, self.receive(self.sink, 20), 30)
+        self.assertEqual(self.activeStreams(2), 2)
+
+    def testSpecialCaseShiftsExact(self):
+        print "Testing that shifts of 0, fs/4, fs/2 and 3fs/4 are exact and phase continuous"
+
+        #Each sample turns the phase by a whole number of quarter cycles, so the expected output
+        #is the input multiplied by 1, j, -1 or -j with no rounding at all. Packets of 7 samples
+        #end part way through a cycle at every shift but 0
+        rotations = [(1.0, 0.0), (0.0, 1.0), (-1.0, 0.0), (0.0, -1.0)]
+        for shift in (0, 250, 500, 750):
+            self.comp.frequency_shift = shift
+            for complexData in (False, True):
+                streamID = "%s_%d" % ("complex" if complexData else "real", shift)
+                width = 2 if complexData else 1
+                for first in (0, 7):
+                    data = [float(x + 1) for x in xrange(first*width, (first + 7)*width)]
+                    self.src.push(data, streamID = streamID, complexData = complexData, sampleRate = 1000.0)
+                    outData = self.receive(self.sink, 14)
+                    self.assertEqual(len(outData), 14)
+                    for x in range(7):
+                        rotationReal, rotationImag = rotations[((x + first)*shift/250) % 4]
+                        inputReal, inputImag = (data[2*x], data[2*x+1]) if complexData else (data[x], 0.0)
+                        self.assertEqual(outData[2*x], inputReal*rotationReal - inputImag*rotationImag)
+                        self.assertEqual(outData[2*x+1], inputReal*rotationImag + inputImag*rotationReal)
+
+    def testShortInputScaled(self):
+        print "Testing that short input is converted, scaled and shifted"
+
+        shortSrc = sb.DataSource(dataFormat="short")
+        shortSrc.connect(self.comp, providesPortName="dataShort_in")
+        shortSrc.start()
+
+        inputData = [x*100 for x in xrange(10)]
+        self.comp.frequency_shift = 200
+        self.comp.input_scale = 0.01
+        shortSrc.push(inputData, complexData = False, sampleRate = 1000.0)
+
+        outData = []
+        for count in xrange(2000):
+            outData = self.sink.getData()
+            if outData:
+                break
+            sleep(.01)
+
+        self.assertEqual(len(inputData)*2, len(outData))
+        for x in range(len(inputData)):
+            resultReal = inputData[x]*0.01 * math.cos(2.0*math.pi*x*self.comp.frequency_shift/1000.0)
+            resultImag = inputData[x]*0.01 * math.sin(2.0*math.pi*x*self.comp.frequency_shift/1000.0)
+            self.assertEqual(round(outData[2*x], 3), round(resultReal, 3))
+            self.assertEqual(round(outData[2*x+1], 3), round(resultImag, 3))
+
+    def receive(self, sink, length):
+        outData = []
+        for count in xrange(2000):
+            data = sink.getData()
+            if isinstance(data, str):
+                data = [ord(x) for x in data]
+            outData += data
+            if len(outData) >= length:
+                break
+            sleep(.01)
+        return outData
+
+    def testQuantizedOutputSaturates(self):
+        print "Testing that short and octet output is scaled, rounded and saturated"
+
+        shortSink = sb.DataSink()
+        octetSink = sb.DataSink()
+        self.comp.connect(shortSink, usesPortName="dataShort_out")
+        self.comp.connect(octetSink, usesPortName="dataOctet_out")
+        shortSink.start()
+        octetSink.start()
+
+        self.comp.frequency_shift = 0
+        self.comp.output_scale = 2.0
+        inputData = [0.4, 0.6, -0.6, -1.4, 100.0, -100.0, 40000.0, -40000.0]
+        self.src.push(inputData, complexData = False, sampleRate = 1000.0)
+
+        shortData = self.receive(shortSink, len(inputData)*2)
+        octetData = self.receive(octetSink, len(inputData)*2)
+        self.assertEqual(shortData[0::2], [1, 1, -1, -3, 200, -200, 32767, -32768])
+        self.assertEqual(shortData[1::2], [0]*len(inputData))
+        self.assertEqual(octetData[0::2], [129, 129, 127, 125, 255, 0, 255, 0])
+        self.assertEqual(octetData[1::2], [128]*len(inputData))
+
+
+    def testDoubleRoundTrip(self):
+        print "Testing that double input is shifted and pushed in double precision"
+
+        doubleSrc = sb.DataSource(dataFormat="double")
+        doubleSink = sb.DataSink()
+        doubleSrc.connect(self.comp, providesPortName="dataDouble_in")
+        self.comp.connect(doubleSink, usesPortName="dataDouble_out")
+        doubleSrc.start()
+        doubleSink.start()
+
+        inputData = [0.123456789012345*(x + 1) for x in xrange(20)]
+        self.comp.frequency_shift = 123
+        doubleSrc.push(inputData, complexData = True, sampleRate = 1000.0)
+
+        outData = self.receive(doubleSink, len(inputData))
+        self.assertEqual(len(inputData), len(outData))
+        for x in range(len(inputData)/2):
+            phase = 2.0*math.pi*x*self.comp.frequency_shift/1000.0
+            resultReal = inputData[2*x]*math.cos(phase) - inputData[2*x+1]*math.sin(phase)
+            resultImag = inputData[2*x+1]*math.cos(phase) + inputData[2*x]*math.sin(phase)
+            self.assertTrue(abs(outData[2*x] - resultReal) < 1e-9)
+            self.assertTrue(abs(outData[2*x+1] - resultImag) < 1e-9)
+
+
+    def testFramedInputShiftedPerChannel(self):
+        print "Testing that each channel of framed input gets its own shift and keeps its phase across packets"
+
+        self.comp.channel_shifts = [100.0, 250.0]
+        port = self.comp.getPort("dataFloat_in")
+        sri = BULKIO.StreamSRI(hversion=1, xstart=0.0, xdelta=0.0005, xunits=1, subsize=2, ystart=0.0,
+                               ydelta=0.001, yunits=1, mode=0, streamID="framed", blocking=False, keywords=[])
+        port.pushSRI(sri)
+
+        #Two packets of 5 frames, each frame holding one sample of each of the 2 channels
+        inputData = [float(x + 1) for x in xrange(20)]
+        T = BULKIO.PrecisionUTCTime(BULKIO.TCM_CPU, BULKIO.TCS_VALID, 0.0, 0.0, 0.0)
+        port.pushPacket(inputData[:10], T, False, "framed")
+        port.pushPacket(inputData[10:], T, True, "framed")
+
+        outData = self.receive(self.sink, len(inputData)*2)
+        self.assertEqual(len(inputData)*2, len(outData))
+        for x in range(len(inputData)):
+            frame = x/2
+            phase = 2.0*math.pi*self.comp.channel_shifts[x%2]*frame*0.001
+            self.assertEqual(round(outData[2*x], 3), round(inputData[x]*math.cos(phase), 3))
+            self.assertEqual(round(outData[2*x+1], 3), round(inputData[x]*math.sin(phase), 3))
+
+
+    def shiftOf(self, streamID, keywords = []):
+        #Pushes a packet on streamID and returns the shift its output was given, or None when
+        #the output does not match any of the shifts these tests configure
+        inputData = [float(x + 1) for x in xrange(10)]
+        self.src.push(inputData, streamID = streamID, complexData = False, sampleRate = 1000.0, SRIKeywords = keywords)
+        outData = self.receive(self.sink, len(inputData)*2)
+        self.assertEqual(len(inputData)*2, len(outData))
+        for shift in (50.0, 100.0, 200.0, 300.0):
+            matched = True
+            for x in range(len(inputData)):
+                phase = 2.0*math.pi*x*shift/1000.0
+                if round(outData[2*x], 3) != round(inputData[x]*math.cos(phase), 3) or \
+                        round(outData[2*x+1], 3) != round(inputData[x]*math.sin(phase), 3):
+                    matched = False
+                    break
+            if matched:
+                return shift
+        return None
+
+    def testStreamFrequencies(self):
+        print "Testing that stream_frequencies entries override frequency_shift, exact entries first"
+
+        self.comp.frequency_shift = 200
+        self.comp.stream_frequencies = [{"stream_frequency::stream_id": "ex*", "stream_frequency::frequency": 300.0},
+                                        {"stream_frequency::stream_id": "exact", "stream_frequency::frequency": 100.0}]
+
+        self.assertEqual(self.shiftOf("exact"), 100.0)
+        self.assertEqual(self.shiftOf("example"), 300.0)
+        self.assertEqual(self.shiftOf("other"), 200.0)
+
+    def testFrequencyKeyword(self):
+        print "Testing that the frequency_keyword SRI keyword overrides stream_frequencies"
+
+        self.comp.frequency_shift = 200
+        self.comp.frequency_keyword = "FREQ_SHIFT"
+        self.comp.stream_frequencies = [{"stream_frequency::stream_id": "exact", "stream_frequency::frequency": 100.0}]
+
+        self.assertEqual(self.shiftOf("exact", [sb.SRIKeyword("FREQ_SHIFT", 50.0, "double")]), 50.0)
+        self.assertEqual(self.shiftOf("keyed", [sb.SRIKeyword("FREQ_SHIFT", 300, "long")]), 300.0)
+        self.assertEqual(self.shiftOf("unkeyed"), 200.0)
+
+    def testCrossStreamLanes(self):
+        print "Testing that short packets of several streams shifted together keep their own shift and phase"
+
+        #Stream k carries the constant k + 1, which tells its output packets apart, and is given
+        #a shift of its own. The packets are queued while the component is stopped, so that they
+        #are waiting together when it starts; batch_size is left at 1
+        shifts = [30.0, 70.0, 110.0, 190.0]
+        self.comp.cross_stream_lanes = 8
+        self.comp.stream_frequencies = [{"stream_frequency::stream_id": "lane%d" % k, "stream_frequency::frequency": shifts[k]}
+                                        for k in range(len(shifts))]
+        self.comp.stop()
+        for packet in range(3):
+            for k in range(len(shifts)):
+                self.src.push([float(k + 1)]*5, streamID = "lane%d" % k, complexData = False, sampleRate = 1000.0)
+        sleep(0.5)
+        self.comp.start()
+
+        outData = self.receive(self.sink, 120)
+        self.assertEqual(len(outData), 120)
+        packets = [0]*len(shifts)
+        for p in range(12):
+            chunk = outData[10*p:10*(p + 1)]
+            k = int(round(math.hypot(chunk[0], chunk[1]))) - 1
+            self.assertShifted([float(k + 1)]*5, chunk, shifts[k], first = 5*packets[k])
+            packets[k] += 1
+        self.assertEqual(packets, [3]*len(shifts))
+
+    def testFilteredStreamKeepsPhase(self):
+        print "Testing that a stream filtered off every output is skipped with its phase carried forward"
+
+        self.comp.frequency_shift = 30
+        self.comp.connectionTable = [{"connectionTable::connection_id": "elsewhere",
+                                      "connectionTable::stream_id": "other",
+                                      "connectionTable::port_name": "dataFloat_out"}]
+
+        inputData = [float(x + 1) for x in xrange(20)]
+        self.src.push(inputData[:10], streamID = "s", complexData = False, sampleRate = 1000.0)
+        sleep(.5)
+        self.assertEqual(self.sink.getData(), [])
+
+        #Once the filter is cleared the stream is pushed again, continuing from the phase its
+        #skipped samples would have left it at. 10 samples at 30 Hz are not a whole cycle, so
+        #restarting at zero phase would not match
+        self.comp.connectionTable = []
+        self.src.push(inputData[10:], streamID = "s", complexData = False, sampleRate = 1000.0)
+        self.assertShifted(inputData[10:], self.receive(self.sink, 20), 30, first = 10)
+
+    def testStreamingKernel(self):
+        print "Testing that the streaming kernel matches the shift of real and complex input"
+
+        #With a threshold of 1 every packet goes through the streaming kernel. Complex float
+        #input is shifted in place, real input is widened into scratch. Packets of 300 and 301
+        #samples cover whole 256-sample chunks, a partial chunk and an odd tail, and 30 Hz is
+        #not a whole number of cycles in either, so the second packet checks the phase carried
+        self.comp.streaming_threshold = 1
+        self.comp.frequency_shift = 30
+        for complexData in (False, True):
+            streamID = "complex" if complexData else "real"
+            width = 2 if complexData else 1
+            first = 0
+            for length in (300, 301):
+                data = [float(x % 17 + 1)/4.0 for x in xrange(length*width)]
+                self.src.push(data, streamID = streamID, complexData = complexData, sampleRate = 1000.0)
+                self.assertShifted(data, self.receive(self.sink, 2*length), 30, first = first, complexData = complexData)
+                first += length
         
 if __name__ == "__main__":
     ossie.utils.testing.main("../FreqShift.spd.xml") # By default tests all implementations